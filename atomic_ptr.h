@@ -0,0 +1,151 @@
+/* atomic_ptr.h - atomic slot holding a shared csptr object
+ *
+ * Readers pick up the current object with satomic_load and get their own
+ * reference, without a lock; writers replace it with store / exchange /
+ * compare_exchange. The slot holds one reference to its object.
+ *
+ * A load publishes the pointer it is about to sref in a per-thread hazard
+ * pointer and re-checks the slot; whoever takes an object out of the slot
+ * waits until no hazard pointer names it before its reference can be
+ * dropped. Readers never wait; writers wait at most for a reader's sref.
+ *
+ *     static s_atomic_ptr config = SATOMIC_PTR_INIT;
+ *
+ *     satomic_store(&config, cfg);                  // writer
+ *     smart struct cfg *c = satomic_load(&config);  // readers
+ *
+ * All objects stored in a slot must be SHARED. Needs <stdatomic.h> and
+ * pthreads.
+ */
+
+#ifndef CSPTR_H_ATOMIC_PTR_H
+#define CSPTR_H_ATOMIC_PTR_H
+
+#include "csptr.h"
+#include <stdatomic.h>
+
+typedef struct {
+    _Atomic(void *) ptr;
+} s_atomic_ptr;
+
+#define SATOMIC_PTR_INIT { NULL }
+
+/* a new reference to the current object, or NULL when the slot is empty.
+ * A thread's first load allocates its hazard record, and aborts if that fails */
+void *satomic_load(s_atomic_ptr *slot);
+/* the slot takes its own reference to `ptr` (may be NULL) and drops the
+ * previous one; satomic_store(slot, NULL) empties a slot before it goes */
+void satomic_store(s_atomic_ptr *slot, void *ptr);
+/* like satomic_store, but hands the previous reference to the caller */
+void *satomic_exchange(s_atomic_ptr *slot, void *ptr);
+/* replaces `*expected` with `desired` and returns 1 when the slot held
+ * `*expected`; otherwise drops the reference in `*expected`, stores a new
+ * reference to the current object there and returns 0 */
+int satomic_compare_exchange(s_atomic_ptr *slot, void **expected, void *desired);
+
+#endif //CSPTR_H_ATOMIC_PTR_H
+
+#if defined(MY_LIBCSPTR_IMPLEMENTATION) && !defined(CSPTR_ATOMIC_PTR_IMPLEMENTED_)
+#define CSPTR_ATOMIC_PTR_IMPLEMENTED_
+#include <pthread.h>
+#include <sched.h>
+
+/* one per thread that loaded from a slot, recycled after the thread exits */
+typedef struct s_hazard_rec_s {
+    _Atomic(void *) ptr;
+    atomic_int active;
+    struct s_hazard_rec_s *next;
+} s_hazard_rec;
+
+static _Atomic(s_hazard_rec *) hazard_list_;
+static _Thread_local s_hazard_rec *hazard_self_;
+static pthread_once_t hazard_once_ = PTHREAD_ONCE_INIT;
+static pthread_key_t hazard_key_;
+
+static void hazard_thread_exit_(void *rec) {
+    atomic_store(&((s_hazard_rec *) rec)->active, 0);
+}
+
+static void hazard_make_key_(void) {
+    pthread_key_create(&hazard_key_, hazard_thread_exit_);
+}
+
+static s_hazard_rec *hazard_acquire_(void) {
+    s_hazard_rec *rec;
+    for (rec = atomic_load(&hazard_list_); rec; rec = rec->next) {
+        int idle = 0;
+        if (atomic_compare_exchange_strong(&rec->active, &idle, 1))
+            break;
+    }
+    if (!rec) {
+        // a NULL load would read as an empty slot: give up like epoch_rec_
+        if (!(rec = malloc(sizeof (s_hazard_rec))))
+            abort();
+        atomic_init(&rec->ptr, NULL);
+        atomic_init(&rec->active, 1);
+        rec->next = atomic_load(&hazard_list_);
+        while (!atomic_compare_exchange_weak(&hazard_list_, &rec->next, rec))
+            ;
+    }
+    pthread_once(&hazard_once_, hazard_make_key_);
+    pthread_setspecific(hazard_key_, rec);
+    return hazard_self_ = rec;
+}
+
+/* `ptr` has left the slot: wait for readers that may still be about to sref it */
+static void hazard_wait_(void *ptr) {
+    if (!ptr)
+        return;
+    for (s_hazard_rec *rec = atomic_load(&hazard_list_); rec; rec = rec->next)
+        while (atomic_load(&rec->ptr) == ptr)
+            sched_yield();
+}
+
+void *satomic_load(s_atomic_ptr *slot) {
+    s_hazard_rec *rec = hazard_self_ ? hazard_self_ : hazard_acquire_();
+
+    void *ptr = atomic_load(&slot->ptr);
+    for (;;) {
+        if (!ptr)
+            return NULL;
+        atomic_store(&rec->ptr, ptr);
+        void *again = atomic_load(&slot->ptr);
+        if (again == ptr)
+            break;
+        ptr = again;
+    }
+    sref(ptr);
+    atomic_store_explicit(&rec->ptr, NULL, memory_order_release);
+    return ptr;
+}
+
+void *satomic_exchange(s_atomic_ptr *slot, void *ptr) {
+    if (ptr)
+        sref(ptr);
+    void *old = atomic_exchange(&slot->ptr, ptr);
+    hazard_wait_(old);
+    return old;
+}
+
+void satomic_store(s_atomic_ptr *slot, void *ptr) {
+    sfree(satomic_exchange(slot, ptr));
+}
+
+int satomic_compare_exchange(s_atomic_ptr *slot, void **expected, void *desired) {
+    void *old = *expected;
+    if (desired)
+        sref(desired);
+    if (atomic_compare_exchange_strong(&slot->ptr, &old, desired)) {
+        // the slot's reference to *expected
+        hazard_wait_(old);
+        sfree(old);
+        return 1;
+    }
+    if (desired)
+        sfree(desired);
+    sfree(*expected);
+    *expected = satomic_load(slot);
+    return 0;
+}
+
+#endif
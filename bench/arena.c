@@ -0,0 +1,53 @@
+#include "bench.h"
+
+#define MY_LIBCSPTR_IMPLEMENTATION
+#include "../csptr.h"
+
+#define REQUESTS 20000
+#define OBJECTS  300
+
+typedef struct {
+    int id;
+    double weight;
+    const char *name;
+} item;
+
+static void item_dtor(void *ptr, void *userdata) {
+    (void) userdata;
+    bench_escape(ptr);
+}
+
+static void *handle_request(int i, s_arena *arena) {
+    if (i % 3 == 0)
+        return shared_ptr(item, {.id = i, .weight = 1.5}, item_dtor, .arena = arena);
+    if (i % 3 == 1)
+        return unique_arr(int, 1 + i % 32, .arena = arena);
+    return shared_ptr(double, i, .arena = arena);
+}
+
+static double run(int use_arena) {
+    static void *live[OBJECTS];
+    s_arena *arena = use_arena ? sarena_new(0) : NULL;
+    double t0 = bench_now();
+    for (int r = 0; r < REQUESTS; ++r) {
+        for (int i = 0; i < OBJECTS; ++i)
+            live[i] = handle_request(i, arena);
+        bench_escape(live);
+        if (use_arena) {
+            sarena_reset(arena);
+        } else {
+            for (int i = 0; i < OBJECTS; ++i)
+                sfree(live[i]);
+        }
+    }
+    double secs = bench_now() - t0;
+    sarena_free(arena);
+    return secs;
+}
+
+int main(void) {
+    const double ops = (double) REQUESTS * OBJECTS;
+    bench_report("per-object smalloc+sfree", ops, run(0));
+    bench_report("arena smalloc+sarena_reset", ops, run(1));
+    return 0;
+}
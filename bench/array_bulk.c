@@ -0,0 +1,91 @@
+#include "bench.h"
+
+#define MY_LIBCSPTR_IMPLEMENTATION
+#include "../csptr.h"
+
+/* loading a batch of ints into a smart array: one arrappend per item
+ * against a single arrappendn / arrextend / arrinsn_values */
+
+#define BATCH  (10 * 1000 * 1000)
+#define ROUNDS 5
+
+static int src[BATCH];
+
+static double per_item(void) {
+    double secs = 0;
+    for (int r = 0; r < ROUNDS; ++r) {
+        double t0 = bench_now();
+        int *a = unique_arr(int, 1);
+        for (int i = 0; i < BATCH; ++i)
+            arrappend(a, src[i]);
+        bench_escape(a);
+        secs += bench_now() - t0;
+        sfree(a);
+    }
+    return secs;
+}
+
+static double appendn(void) {
+    double secs = 0;
+    for (int r = 0; r < ROUNDS; ++r) {
+        double t0 = bench_now();
+        int *a = unique_arr(int, 1);
+        arrappendn(a, src, BATCH);
+        bench_escape(a);
+        secs += bench_now() - t0;
+        sfree(a);
+    }
+    return secs;
+}
+
+static double extend(void) {
+    int *b = unique_arr(int, BATCH, src);
+    double secs = 0;
+    for (int r = 0; r < ROUNDS; ++r) {
+        double t0 = bench_now();
+        int *a = unique_arr(int, 1);
+        arrextend(a, b);
+        bench_escape(a);
+        secs += bench_now() - t0;
+        sfree(a);
+    }
+    sfree(b);
+    return secs;
+}
+
+/* a small batch in front of a large array, over and over */
+#define FRONT_ARRAY 100000
+#define FRONT_BATCH 64
+#define FRONT_ROUNDS 200
+
+static double insert_front(int bulk) {
+    int *a = unique_arr(int, FRONT_ARRAY, src);
+    arrreserve(a, FRONT_ARRAY + FRONT_BATCH * FRONT_ROUNDS);
+    double t0 = bench_now();
+    for (int r = 0; r < FRONT_ROUNDS; ++r) {
+        if (bulk) {
+            arrinsn_values(a, 0, src, FRONT_BATCH);
+        } else {
+            for (int i = FRONT_BATCH; i--; )
+                arrins(a, 0, src[i]);
+        }
+    }
+    bench_escape(a);
+    double secs = bench_now() - t0;
+    sfree(a);
+    return secs;
+}
+
+int main(void) {
+    for (int i = 0; i < BATCH; ++i)
+        src[i] = i;
+    const double ops = (double) BATCH * ROUNDS;
+    bench_report("arrappend per item", ops, per_item());
+    bench_report("arrappendn", ops, appendn());
+    bench_report("arrextend", ops, extend());
+
+    const double front = (double) FRONT_BATCH * FRONT_ROUNDS;
+    bench_report("arrins per item at 0", front, insert_front(0));
+    bench_report("arrinsn_values at 0", front, insert_front(1));
+    return 0;
+}
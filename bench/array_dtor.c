@@ -0,0 +1,65 @@
+#include "bench.h"
+
+#define MY_LIBCSPTR_IMPLEMENTATION
+#include "../csptr.h"
+
+/* tearing down a 1M-item array of structs: a per-item f_destructor (one
+ * indirect call per item), an f_array_destructor (one call) and no
+ * destructor at all (trivially destructible). The last one does no work per
+ * item, so all three are also reported per teardown, free included. */
+
+#define ITEMS  (1000 * 1000)
+#define ROUNDS 20
+
+typedef struct {
+    int id;
+    int refs;
+    double weight;
+} entry;
+
+static long released;
+
+static void entry_dtor(void *ptr, void *userdata) {
+    (void) userdata;
+    released += ((entry *) ptr)->refs;
+}
+
+static void entries_dtor(void *base, size_t count, size_t item_size, void *userdata) {
+    (void) item_size;
+    (void) userdata;
+    const entry *e = base;
+    long sum = 0;
+    for (size_t i = 0; i < count; ++i)
+        sum += e[i].refs;
+    released += sum;
+}
+
+static entry src[ITEMS];
+
+static double teardown(f_destructor dtor, f_array_destructor array_dtor) {
+    double secs = 0;
+    for (int r = 0; r < ROUNDS; ++r) {
+        entry *a = unique_arr(entry, ITEMS, src, dtor, .array_dtor = array_dtor);
+        double t0 = bench_now();
+        sfree(a);
+        secs += bench_now() - t0;
+    }
+    return secs;
+}
+
+int main(void) {
+    for (int i = 0; i < ITEMS; ++i)
+        src[i] = (entry) {.id = i, .refs = 1, .weight = i * 0.5};
+    const double ops = (double) ITEMS * ROUNDS;
+    const double per_item = teardown(entry_dtor, NULL);
+    const double array = teardown(NULL, entries_dtor);
+    const double trivial = teardown(NULL, NULL);
+    bench_report("teardown: per-item dtor", ops, per_item);
+    bench_report("teardown: array dtor", ops, array);
+    printf("%-40s %10.2f us per teardown\n", "teardown: per-item dtor", per_item * 1e6 / ROUNDS);
+    printf("%-40s %10.2f us per teardown\n", "teardown: array dtor", array * 1e6 / ROUNDS);
+    printf("%-40s %10.2f us per teardown\n", "teardown: trivially destructible", trivial * 1e6 / ROUNDS);
+    if (released != 2L * ITEMS * ROUNDS)
+        printf("released %ld items, expected %ld\n", released, 2L * ITEMS * ROUNDS);
+    return 0;
+}
@@ -0,0 +1,86 @@
+#include "bench.h"
+
+#define MY_LIBCSPTR_IMPLEMENTATION
+#include "../csptr.h"
+
+/* an expiry sweep: drop every item whose deadline has passed, about one in
+ * ten spread over the array, with arrdel in a loop and with arr_remove_if;
+ * then single random deletes with arrdel and arrdelswap */
+
+#define ITEMS 200000
+#define ROUNDS 5
+
+typedef struct {
+    unsigned deadline;
+    unsigned id;
+} timer;
+
+static unsigned rng_ = 12345;
+static unsigned rnd_(void) {
+    rng_ = rng_ * 1103515245u + 12345u;
+    return rng_ >> 8;
+}
+
+static timer *fill_(void) {
+    rng_ = 12345;
+    timer *a = unique_arr(timer, ITEMS);
+    for (unsigned i = 0; i < ITEMS; ++i)
+        arrappend(a, ((timer) {.deadline = rnd_() % 1000, .id = i}));
+    return a;
+}
+
+static int expired(const void *item, void *now) {
+    return ((const timer *) item)->deadline < *(unsigned *) now;
+}
+
+static double sweep(int single_pass, size_t *left) {
+    double secs = 0;
+    for (int r = 0; r < ROUNDS; ++r) {
+        timer *a = fill_();
+        unsigned now = 100;
+        double t0 = bench_now();
+        if (single_pass) {
+            arr_remove_if(a, expired, &now);
+        } else {
+            for (size_t i = 0; i < arrlenu(a); )
+                if (expired(&a[i], &now))
+                    arrdel(a, i);
+                else
+                    ++i;
+        }
+        secs += bench_now() - t0;
+        *left = arrlenu(a);
+        sfree(a);
+    }
+    return secs;
+}
+
+#define DELETES (ITEMS / 2)
+
+static double random_deletes(int swap) {
+    timer *a = fill_();
+    double t0 = bench_now();
+    for (int i = 0; i < DELETES; ++i) {
+        size_t at = rnd_() % arrlenu(a);
+        if (swap)
+            arrdelswap(a, at);
+        else
+            arrdel(a, at);
+    }
+    bench_escape(a);
+    double secs = bench_now() - t0;
+    sfree(a);
+    return secs;
+}
+
+int main(void) {
+    size_t left_loop, left_pass;
+    const double items = (double) ITEMS * ROUNDS;
+    bench_report("expiry sweep: arrdel loop (per item)", items, sweep(0, &left_loop));
+    bench_report("expiry sweep: arr_remove_if (per item)", items, sweep(1, &left_pass));
+    if (left_loop != left_pass)
+        printf("mismatch: %zu vs %zu items left\n", left_loop, left_pass);
+    bench_report("random delete: arrdel", DELETES, random_deletes(0));
+    bench_report("random delete: arrdelswap", DELETES, random_deletes(1));
+    return 0;
+}
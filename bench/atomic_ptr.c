@@ -0,0 +1,93 @@
+#include "bench.h"
+
+#define MY_LIBCSPTR_IMPLEMENTATION
+#include "../csptr.h"
+#include "../atomic_ptr.h"
+#include <pthread.h>
+
+/* one writer republishing a snapshot while N readers pick it up:
+ * mutex around load + sref vs s_atomic_ptr */
+
+#define READS 2000000
+#define MAX_READERS 8
+
+typedef struct {
+    int version;
+    int routes[16];
+} table;
+
+static s_atomic_ptr slot = SATOMIC_PTR_INIT;
+static table *locked_table;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static atomic_int readers_left;
+static int use_slot;
+
+static table *read_table(void) {
+    if (use_slot)
+        return satomic_load(&slot);
+    pthread_mutex_lock(&lock);
+    table *t = sref(locked_table);
+    pthread_mutex_unlock(&lock);
+    return t;
+}
+
+static void publish(int version) {
+    table *t = shared_ptr(table, { .version = version });
+    if (use_slot) {
+        satomic_store(&slot, t);
+        sfree(t);
+        return;
+    }
+    pthread_mutex_lock(&lock);
+    table *old = locked_table;
+    locked_table = t;
+    pthread_mutex_unlock(&lock);
+    sfree(old);
+}
+
+static void *reader(void *arg) {
+    (void) arg;
+    for (int i = 0; i < READS; ++i) {
+        table *t = read_table();
+        bench_escape(t);
+        sfree(t);
+    }
+    --readers_left;
+    return NULL;
+}
+
+static double run(int slot_mode, int readers) {
+    pthread_t t[MAX_READERS];
+    use_slot = slot_mode;
+    publish(0);
+    readers_left = readers;
+    double t0 = bench_now();
+    for (int i = 0; i < readers; ++i)
+        pthread_create(&t[i], NULL, reader, NULL);
+    for (int v = 1; readers_left; ++v) {
+        publish(v);
+        sched_yield();
+    }
+    for (int i = 0; i < readers; ++i)
+        pthread_join(t[i], NULL);
+    double secs = bench_now() - t0;
+    if (use_slot) {
+        satomic_store(&slot, NULL);
+    } else {
+        sfree(locked_table);
+        locked_table = NULL;
+    }
+    return secs;
+}
+
+int main(void) {
+    char name[64];
+    for (int n = 1; n <= MAX_READERS; n *= 2) {
+        const double ops = (double) READS * n;
+        snprintf(name, sizeof name, "mutex+sref load, %d readers", n);
+        bench_report(name, ops, run(0, n));
+        snprintf(name, sizeof name, "satomic_load, %d readers", n);
+        bench_report(name, ops, run(1, n));
+    }
+    return 0;
+}
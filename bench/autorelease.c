@@ -0,0 +1,67 @@
+#include "bench.h"
+
+#define MY_LIBCSPTR_IMPLEMENTATION
+#include "../csptr.h"
+
+/* a request loop whose helpers return shared_ptr results the caller only
+ * reads: a smart variable released at every scope exit vs registering them
+ * with a per-request autorelease pool. Hot lookups keep returning the same
+ * cached route, the pool drops those references with one atomic; misses
+ * build a fresh one every time. */
+
+#define REQUESTS (1 << 20)
+#define LOOKUPS  8
+#define ROUTES   4
+
+typedef struct {
+    int id;
+    int weight;
+} route;
+
+static route *routes[ROUTES];
+static int miss;
+
+// the cached route or, on a miss, a freshly built one
+static route *lookup(int key) {
+    if (miss)
+        return shared_ptr(route, { key, 1 });
+    return sref(routes[key % ROUTES]);
+}
+
+static double run_smart(void) {
+    long sum = 0;
+    double t0 = bench_now();
+    for (int r = 0; r < REQUESTS; ++r) {
+        for (int i = 0; i < LOOKUPS; ++i) {
+            smart route *rt = lookup(r);
+            sum += rt->weight;
+        }
+    }
+    bench_escape(sum);
+    return bench_now() - t0;
+}
+
+static double run_pool(void) {
+    long sum = 0;
+    double t0 = bench_now();
+    for (int r = 0; r < REQUESTS; ++r) {
+        autorelease_pool;
+        for (int i = 0; i < LOOKUPS; ++i)
+            sum += ((route *) sautorelease(lookup(r)))->weight;
+    }
+    bench_escape(sum);
+    return bench_now() - t0;
+}
+
+int main(void) {
+    for (int i = 0; i < ROUTES; ++i)
+        routes[i] = shared_ptr(route, { i, 1 });
+    for (miss = 0; miss < 2; ++miss) {
+        printf("%s lookups\n", miss ? "missing" : "hot");
+        bench_report("smart result per lookup", REQUESTS, run_smart());
+        bench_report("autorelease_pool per request", REQUESTS, run_pool());
+    }
+    for (int i = 0; i < ROUTES; ++i)
+        sfree(routes[i]);
+    return 0;
+}
@@ -0,0 +1,65 @@
+#include "bench.h"
+
+#define MY_LIBCSPTR_IMPLEMENTATION
+#include "../csptr.h"
+
+/* fan-out: hand one object to FANOUT consumers; bulk release: drop a
+ * vector of references, a mix of fanned-out copies and last references */
+
+#define ROUNDS 200000
+#define FANOUT 16
+#define VECTOR 1024
+
+static void *consumers[FANOUT];
+
+static double fanout(int batched) {
+    int *p = shared_ptr(int, 1);
+    double t0 = bench_now();
+    for (int r = 0; r < ROUNDS; ++r) {
+        if (batched) {
+            sref_n(p, FANOUT);
+            for (int i = 0; i < FANOUT; ++i)
+                consumers[i] = p;
+        } else {
+            for (int i = 0; i < FANOUT; ++i)
+                consumers[i] = sref(p);
+        }
+        bench_escape(consumers);
+        sfree_many(consumers, FANOUT);
+    }
+    double secs = bench_now() - t0;
+    sfree(p);
+    return secs;
+}
+
+static double release(int batched) {
+    static void *vec[VECTOR];
+    double secs = 0;
+    for (int r = 0; r < ROUNDS / 100; ++r) {
+        for (int i = 0; i < VECTOR; i += 4) {
+            vec[i] = shared_ptr(double, i);
+            vec[i + 1] = sref(vec[i]);
+            vec[i + 2] = unique_ptr(int, i);
+            vec[i + 3] = shared_arr(int, 8);
+        }
+        double t0 = bench_now();
+        if (batched) {
+            sfree_many(vec, VECTOR);
+        } else {
+            for (int i = 0; i < VECTOR; ++i)
+                sfree(vec[i]);
+        }
+        secs += bench_now() - t0;
+    }
+    return secs;
+}
+
+int main(void) {
+    const double fan_ops = (double) ROUNDS * FANOUT;
+    bench_report("fan-out: sref x16", fan_ops, fanout(0));
+    bench_report("fan-out: sref_n(16)", fan_ops, fanout(1));
+    const double rel_ops = (double) ROUNDS / 100 * VECTOR;
+    bench_report("release: sfree loop", rel_ops, release(0));
+    bench_report("release: sfree_many", rel_ops, release(1));
+    return 0;
+}
@@ -0,0 +1,23 @@
+/* bench.h - tiny timing helpers shared by the csptr benchmarks */
+#ifndef CSPTR_H_BENCH_H
+#define CSPTR_H_BENCH_H
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <time.h>
+
+static inline double bench_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+/* print `ops` operations done in `secs` as Mops/s and ns/op */
+static inline void bench_report(const char *name, double ops, double secs) {
+    printf("%-40s %10.2f Mops/s %8.2f ns/op\n", name, ops / secs * 1e-6, secs * 1e9 / ops);
+}
+
+/* keep the optimizer from discarding `p` */
+#define bench_escape(p) __asm__ volatile("" : : "g"(p) : "memory")
+
+#endif //CSPTR_H_BENCH_H
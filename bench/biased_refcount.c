@@ -0,0 +1,71 @@
+#include "bench.h"
+
+#define MY_LIBCSPTR_IMPLEMENTATION
+#include "../csptr.h"
+#include <pthread.h>
+
+/* each thread churns references to objects it allocated itself, and now and
+ * then to one owned by its neighbour; atomic SHARED vs SHARED_BIASED */
+
+#define ROUNDS  4000000
+#define OBJECTS 16
+#define MAX_THREADS 8
+
+static int *objs[MAX_THREADS][OBJECTS];
+static enum pointer_kind kind;
+static int nthreads;
+static pthread_barrier_t start;
+
+static void *churn(void *arg) {
+    const int self = (int) (size_t) arg;
+    int **mine = objs[self], **other = objs[(self + 1) % nthreads];
+    for (int r = 0; r < ROUNDS; ++r) {
+        int *p = sref((r & 63) ? mine[r % OBJECTS] : other[r % OBJECTS]);
+        bench_escape(p);
+        sfree(p);
+    }
+    return NULL;
+}
+
+/* owners allocate and then churn on the same thread */
+static void *owner(void *arg) {
+    const int self = (int) (size_t) arg;
+    for (int i = 0; i < OBJECTS; ++i)
+        objs[self][i] = kind == SHARED ? shared_ptr(int, i) : shared_biased_ptr(int, i);
+    pthread_barrier_wait(&start);
+    churn(arg);
+    pthread_barrier_wait(&start);
+    for (int i = 0; i < OBJECTS; ++i)
+        sfree(objs[self][i]);
+    sbiased_collect();
+    return NULL;
+}
+
+static double run(enum pointer_kind k, int n) {
+    pthread_t t[MAX_THREADS];
+    kind = k;
+    nthreads = n;
+    pthread_barrier_init(&start, NULL, n + 1);
+    for (int i = 0; i < n; ++i)
+        pthread_create(&t[i], NULL, owner, (void *) (size_t) i);
+    pthread_barrier_wait(&start);
+    double t0 = bench_now();
+    pthread_barrier_wait(&start);
+    double secs = bench_now() - t0;
+    for (int i = 0; i < n; ++i)
+        pthread_join(t[i], NULL);
+    pthread_barrier_destroy(&start);
+    return secs;
+}
+
+int main(void) {
+    char name[64];
+    for (int n = 1; n <= MAX_THREADS; n *= 2) {
+        const double ops = (double) ROUNDS * n;
+        snprintf(name, sizeof name, "SHARED sref+sfree, %d threads", n);
+        bench_report(name, ops, run(SHARED, n));
+        snprintf(name, sizeof name, "SHARED_BIASED sref+sfree, %d threads", n);
+        bench_report(name, ops, run(SHARED_BIASED, n));
+    }
+    return 0;
+}
@@ -0,0 +1,65 @@
+#include "bench.h"
+
+#define MY_LIBCSPTR_IMPLEMENTATION
+#include "../csptr.h"
+#include <pthread.h>
+
+/* readers keeping a published object alive for one short read:
+ * sref+sfree on the shared count vs an epoch critical section */
+
+#define TOTAL_READS (1 << 24)
+#define MAX_THREADS 64
+
+typedef struct {
+    int version;
+    int routes[16];
+} table;
+
+static _Atomic(table *) current;
+static int use_epoch;
+static long reads_per_thread;
+
+static void *reader(void *arg) {
+    (void) arg;
+    long sum = 0;
+    for (long i = 0; i < reads_per_thread; ++i) {
+        if (use_epoch) {
+            sepoch_enter();
+            sum += atomic_load_explicit(&current, memory_order_acquire)->routes[i & 15];
+            sepoch_leave();
+        } else {
+            // the writer never replaces the table here, so the load is safe
+            table *t = sref(atomic_load_explicit(&current, memory_order_acquire));
+            sum += t->routes[i & 15];
+            sfree(t);
+        }
+    }
+    bench_escape(sum);
+    return NULL;
+}
+
+static double run(int epoch, int threads) {
+    pthread_t t[MAX_THREADS];
+    use_epoch = epoch;
+    reads_per_thread = TOTAL_READS / threads;
+    double t0 = bench_now();
+    for (int i = 0; i < threads; ++i)
+        pthread_create(&t[i], NULL, reader, NULL);
+    for (int i = 0; i < threads; ++i)
+        pthread_join(t[i], NULL);
+    return bench_now() - t0;
+}
+
+int main(void) {
+    atomic_store(&current, shared_epoch_ptr(table, { .version = 1 }));
+    char name[64];
+    for (int n = 1; n <= MAX_THREADS; n *= 2) {
+        snprintf(name, sizeof name, "sref+sfree read, %d threads", n);
+        bench_report(name, TOTAL_READS, run(0, n));
+        snprintf(name, sizeof name, "sepoch_enter/leave read, %d threads", n);
+        bench_report(name, TOTAL_READS, run(1, n));
+    }
+    sfree(atomic_exchange(&current, NULL));
+    sepoch_flush();
+    return 0;
+}
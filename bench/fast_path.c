@@ -0,0 +1,59 @@
+#include "bench.h"
+
+#define MY_LIBCSPTR_IMPLEMENTATION
+#include "../csptr.h"
+
+/* unique_ptr(int, 42) + sfree through smalloc_impl_ / sfree_impl_ against
+ * the inline smalloc_fast_ / sfree path smart_ptr picks at -O2 */
+
+#define ROUNDS 20000000
+
+static double generic_unique(void) {
+    const int value = 42;
+    double t0 = bench_now();
+    for (int i = 0; i < ROUNDS; ++i) {
+        int *p = smalloc(sizeof (int), 1, 1, UNIQUE, .value = &value);
+        bench_escape(p);
+        sfree_impl_(p);
+    }
+    return bench_now() - t0;
+}
+
+static double fast_unique(void) {
+    double t0 = bench_now();
+    for (int i = 0; i < ROUNDS; ++i) {
+        int *p = unique_ptr(int, 42);
+        bench_escape(p);
+        sfree(p);
+    }
+    return bench_now() - t0;
+}
+
+static double generic_shared(void) {
+    const double value = 1.5;
+    double t0 = bench_now();
+    for (int i = 0; i < ROUNDS; ++i) {
+        double *p = smalloc(sizeof (double), 1, 1, SHARED, .value = &value);
+        bench_escape(p);
+        sfree(p);
+    }
+    return bench_now() - t0;
+}
+
+static double fast_shared(void) {
+    double t0 = bench_now();
+    for (int i = 0; i < ROUNDS; ++i) {
+        double *p = shared_ptr(double, 1.5);
+        bench_escape(p);
+        sfree(p);
+    }
+    return bench_now() - t0;
+}
+
+int main(void) {
+    bench_report("unique_ptr(int): smalloc_impl_+sfree_impl_", ROUNDS, generic_unique());
+    bench_report("unique_ptr(int): inline fast path", ROUNDS, fast_unique());
+    bench_report("shared_ptr(double): smalloc_impl_", ROUNDS, generic_shared());
+    bench_report("shared_ptr(double): inline fast path", ROUNDS, fast_shared());
+    return 0;
+}
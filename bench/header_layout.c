@@ -0,0 +1,46 @@
+#include "bench.h"
+
+#define MY_LIBCSPTR_IMPLEMENTATION
+#include "../csptr.h"
+
+/* header lookups on the hot paths; build with -DCSPTR_FIXED_HEADER to
+ * compare against the offset-word layout */
+
+#define ROUNDS 20000000
+#define ARRAYS 1024
+
+int main(void) {
+#if defined(CSPTR_FIXED_HEADER)
+    puts("layout: fixed");
+#elif defined(CSPTR_COMPACT_HEADER)
+    puts("layout: compact");
+#else
+    puts("layout: default");
+#endif
+    static int *arrays[ARRAYS];
+    for (int i = 0; i < ARRAYS; ++i)
+        arrays[i] = shared_arr(int, 1 + i % 16, .value = (int[16]) {0});
+
+    double t0 = bench_now();
+    for (int r = 0; r < ROUNDS; ++r) {
+        int *p = arrays[r % ARRAYS];
+        sref(p);
+        bench_escape(p);
+        sfree(p);
+    }
+    bench_report("sref+sfree", ROUNDS, bench_now() - t0);
+
+    size_t total = 0;
+    t0 = bench_now();
+    for (int r = 0; r < ROUNDS; ++r) {
+        int *p = arrays[r % ARRAYS];
+        bench_escape(p);
+        total += static_array.length(p);
+    }
+    bench_report("static_array.length", ROUNDS, bench_now() - t0);
+    bench_escape(total);
+
+    for (int i = 0; i < ARRAYS; ++i)
+        sfree(arrays[i]);
+    return 0;
+}
@@ -0,0 +1,45 @@
+#include "bench.h"
+
+#define MY_LIBCSPTR_IMPLEMENTATION
+#include "../csptr.h"
+
+/* bytes requested from the allocator per object, and how much of that is
+ * meta data; build with -DCSPTR_COMPACT_HEADER or -DCSPTR_FIXED_HEADER to compare layouts */
+
+static size_t last_request;
+
+static void *counting_malloc(size_t size) {
+    last_request = size;
+    return malloc(size);
+}
+
+static void dtor(void *ptr, void *meta) {
+    (void) meta;
+    bench_escape(ptr);
+}
+
+static void report(const char *name, void *ptr, size_t payload) {
+    printf("%-40s %6zu bytes/object %6zu meta\n", name, last_request, last_request - payload);
+    sfree(ptr);
+}
+
+int main(void) {
+    smalloc_allocator = (s_allocator) {counting_malloc, free, realloc, NULL};
+    const int ud = 0;
+
+#if defined(CSPTR_COMPACT_HEADER)
+    puts("layout: compact");
+#elif defined(CSPTR_FIXED_HEADER)
+    puts("layout: fixed");
+#else
+    puts("layout: default");
+#endif
+    report("unique_ptr(int)", unique_ptr(int, 1), sizeof (int));
+    report("shared_ptr(int)", shared_ptr(int, 1), sizeof (int));
+    report("shared_ptr(int) + dtor", shared_ptr(int, 1, dtor), sizeof (int));
+    report("shared_ptr(int) + dtor + userdata(int)",
+           shared_ptr(int, 1, dtor, { &ud, sizeof (ud) }), sizeof (int));
+    report("unique_arr(int, 4)", unique_arr(int, 4), 4 * sizeof (int));
+    report("shared_arr(int, 4) + dtor", shared_arr(int, 4, .dtor = dtor), 4 * sizeof (int));
+    return 0;
+}
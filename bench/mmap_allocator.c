@@ -0,0 +1,36 @@
+#include "bench.h"
+#include <stdlib.h>
+
+#define MY_LIBCSPTR_IMPLEMENTATION
+#include "../csptr.h"
+#include "../mmap_allocator.h"
+
+static const s_mmap_allocator thp_config = { .threshold = MMAP_DEFAULT_THRESHOLD, .huge_pages = 1 };
+static const s_alloc_handle thp_handle = MMAP_HANDLE_OF(&thp_config);
+
+static double append(const s_alloc_handle *handle, size_t n) {
+    double t0 = bench_now();
+    int *a = unique_arr(int, 4, .allocator = handle);
+    for (size_t i = 0; i < n; ++i)
+        arrappend(a, (int) i);
+    bench_escape(a);
+    double secs = bench_now() - t0;
+    sfree(a);
+    return secs;
+}
+
+int main(int argc, char *argv[]) {
+    // pass a smaller upper bound on memory-constrained machines
+    const size_t sizes[] = { 1000000, argc > 1 ? strtoul(argv[1], NULL, 10) : 100000000 };
+    for (size_t i = 0; i < sizeof (sizes) / sizeof (sizes[0]); ++i) {
+        const size_t n = sizes[i];
+        char name[64];
+        snprintf(name, sizeof name, "realloc  arrappend x%zu", n);
+        bench_report(name, (double) n, append(&smalloc_default_handle, n));
+        snprintf(name, sizeof name, "mremap   arrappend x%zu", n);
+        bench_report(name, (double) n, append(&mmap_alloc_handle, n));
+        snprintf(name, sizeof name, "mremap+THP arrappend x%zu", n);
+        bench_report(name, (double) n, append(&thp_handle, n));
+    }
+    return 0;
+}
@@ -0,0 +1,60 @@
+#include "bench.h"
+
+#define MY_LIBCSPTR_IMPLEMENTATION
+#include "../csptr.h"
+#include <stdlib.h>
+
+/* per-request latency of dropping the last reference to a small object
+ * graph whose destructor cascades into its children: released inline vs
+ * handed to the background reclaimer */
+
+#define REQUESTS 100000
+#define CHILDREN 64
+
+typedef struct {
+    int *children[CHILDREN];
+} session;
+
+static void session_dtor(void *ptr, void *userdata) {
+    (void) userdata;
+    session *s = ptr;
+    for (int i = 0; i < CHILDREN; ++i)
+        sfree(s->children[i]);
+}
+
+static double lat[REQUESTS];
+
+static int cmp_(const void *a, const void *b) {
+    const double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+static void run(const char *name, int mode) {
+    csptr_reclaim_defer(mode);
+    double total = 0;
+    for (int r = 0; r < REQUESTS; ++r) {
+        session *s = shared_ptr(session, {0}, session_dtor);
+        for (int i = 0; i < CHILDREN; ++i)
+            s->children[i] = shared_ptr(int, i);
+        bench_escape(s);
+        const double t0 = bench_now();
+        sfree(s);
+        lat[r] = bench_now() - t0;
+        total += lat[r];
+    }
+    csptr_reclaim_flush();
+    csptr_reclaim_defer(CSPTR_RECLAIM_OFF);
+
+    qsort(lat, REQUESTS, sizeof *lat, cmp_);
+    bench_report(name, REQUESTS, total);
+    printf("%-40s p50 %7.0f  p99 %7.0f  p999 %7.0f  max %9.0f ns\n", "",
+           lat[REQUESTS / 2] * 1e9, lat[REQUESTS * 99 / 100] * 1e9,
+           lat[REQUESTS * 999 / 1000] * 1e9, lat[REQUESTS - 1] * 1e9);
+}
+
+int main(void) {
+    run("release inline", CSPTR_RECLAIM_OFF);
+    // session_dtor only drops SHARED children, so it may run elsewhere
+    run("release deferred", CSPTR_RECLAIM_ALL);
+    return 0;
+}
@@ -0,0 +1,79 @@
+#include "bench.h"
+
+#define MY_LIBCSPTR_IMPLEMENTATION
+#include "../csptr.h"
+#include "../slab_allocator.h"
+#include <pthread.h>
+#include <sched.h>
+
+/* producer threads allocate unique_ptr messages, their consumer threads
+ * sfree them: every free lands on a thread that did not allocate the
+ * block. Pairs talk through a single-producer single-consumer ring. */
+
+#define TOTAL_MSGS (1 << 21)
+#define MAX_PAIRS  8
+#define RING       256
+
+typedef struct {
+    long seq;
+    char body[24];
+} message;
+
+typedef struct {
+    _Atomic(message *) slot[RING];
+    long count;
+} s_pipe;
+
+static s_pipe pipes[MAX_PAIRS];
+
+static void *produce(void *arg) {
+    s_pipe *p = arg;
+    for (long i = 0; i < p->count; ++i) {
+        message *m = unique_ptr(message, { .seq = i });
+        _Atomic(message *) *slot = &p->slot[i % RING];
+        while (atomic_load_explicit(slot, memory_order_relaxed))
+            sched_yield();
+        atomic_store_explicit(slot, m, memory_order_release);
+    }
+    return NULL;
+}
+
+static void *consume(void *arg) {
+    s_pipe *p = arg;
+    long sum = 0;
+    for (long i = 0; i < p->count; ++i) {
+        _Atomic(message *) *slot = &p->slot[i % RING];
+        message *m;
+        while (!(m = atomic_exchange_explicit(slot, NULL, memory_order_acquire)))
+            sched_yield();
+        sum += m->seq;
+        sfree(m);
+    }
+    bench_escape(sum);
+    return NULL;
+}
+
+static double run(int pairs) {
+    pthread_t t[2 * MAX_PAIRS];
+    double t0 = bench_now();
+    for (int i = 0; i < pairs; ++i) {
+        pipes[i].count = TOTAL_MSGS / pairs;
+        pthread_create(&t[2 * i], NULL, produce, &pipes[i]);
+        pthread_create(&t[2 * i + 1], NULL, consume, &pipes[i]);
+    }
+    for (int i = 0; i < 2 * pairs; ++i)
+        pthread_join(t[i], NULL);
+    return bench_now() - t0;
+}
+
+int main(void) {
+    char name[64];
+    for (int slab = 0; slab < 2; ++slab) {
+        smalloc_allocator = slab ? slab_allocator : (s_allocator){malloc, free, realloc, NULL};
+        for (int n = 1; n <= MAX_PAIRS; n *= 2) {
+            snprintf(name, sizeof name, "%s: %d producer/consumer pairs", slab ? "slab  " : "malloc", n);
+            bench_report(name, TOTAL_MSGS, run(n));
+        }
+    }
+    return 0;
+}
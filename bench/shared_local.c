@@ -0,0 +1,37 @@
+#include "bench.h"
+
+#define MY_LIBCSPTR_IMPLEMENTATION
+#include "../csptr.h"
+
+/* reference churn: copies of a handful of shared objects taken and dropped
+ * on one thread, as when passing them down a call tree */
+
+#define ROUNDS  20000000
+#define OBJECTS 64
+
+static double churn(enum pointer_kind kind) {
+    static int *objs[OBJECTS];
+    for (int i = 0; i < OBJECTS; ++i)
+        objs[i] = kind == SHARED ? shared_ptr(int, i) : shared_local_ptr(int, i);
+
+    double t0 = bench_now();
+    for (int r = 0; r < ROUNDS; ++r) {
+        int *p = sref(objs[r % OBJECTS]);
+        int *q = sref(p);
+        bench_escape(q);
+        sfree(q);
+        sfree(p);
+    }
+    double secs = bench_now() - t0;
+
+    for (int i = 0; i < OBJECTS; ++i)
+        sfree(objs[i]);
+    return secs;
+}
+
+int main(void) {
+    const double ops = 2.0 * ROUNDS;
+    bench_report("SHARED sref+sfree", ops, churn(SHARED));
+    bench_report("SHARED_LOCAL sref+sfree", ops, churn(SHARED_LOCAL));
+    return 0;
+}
@@ -0,0 +1,47 @@
+#include "bench.h"
+
+#define MY_LIBCSPTR_IMPLEMENTATION
+#include "../csptr.h"
+#include "../slab_allocator.h"
+
+#define ROUNDS 2000
+#define BATCH  1000
+
+static double churn_unique_int(void) {
+    static int *live[BATCH];
+    double t0 = bench_now();
+    for (int r = 0; r < ROUNDS; ++r) {
+        for (int i = 0; i < BATCH; ++i)
+            live[i] = unique_ptr(int, i);
+        bench_escape(live);
+        for (int i = 0; i < BATCH; ++i)
+            sfree(live[i]);
+    }
+    return bench_now() - t0;
+}
+
+static double churn_shared_mixed(void) {
+    static void *live[BATCH];
+    double t0 = bench_now();
+    for (int r = 0; r < ROUNDS; ++r) {
+        for (int i = 0; i < BATCH; ++i)
+            live[i] = (i & 1) ? (void *) shared_ptr(double, i) : (void *) shared_arr(int, 1 + i % 24);
+        bench_escape(live);
+        for (int i = BATCH; i--; )
+            sfree(live[i]);
+    }
+    return bench_now() - t0;
+}
+
+int main(void) {
+    const double ops = (double) ROUNDS * BATCH;
+
+    smalloc_allocator = (s_allocator){malloc, free, realloc, NULL};
+    bench_report("malloc: unique_ptr(int) smalloc+sfree", ops, churn_unique_int());
+    bench_report("malloc: shared ptr/arr smalloc+sfree", ops, churn_shared_mixed());
+
+    smalloc_allocator = slab_allocator;
+    bench_report("slab:   unique_ptr(int) smalloc+sfree", ops, churn_unique_int());
+    bench_report("slab:   shared ptr/arr smalloc+sfree", ops, churn_shared_mixed());
+    return 0;
+}
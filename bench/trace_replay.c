@@ -0,0 +1,443 @@
+#include "bench.h"
+#include <malloc.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define MY_LIBCSPTR_IMPLEMENTATION
+#include "../csptr.h"
+#include "../slab_allocator.h"
+#include "../mmap_allocator.h"
+
+/* Replays a CSPTR_TRACE log against several allocators, in file order on
+ * one thread, and reports each one's throughput and memory use:
+ *
+ *     bench/trace_replay [trace]
+ *
+ * Without a trace it records a synthetic request-serving workload first.
+ * Every backend runs in a forked child so peak RSS is its own. Only block
+ * allocations, reallocations and releases reach the allocator; sref and
+ * sfree are counted but cost nothing here. */
+
+#define REQUESTS  10000
+#define CACHE     512
+#define TEMPS     16
+#define PAGE      4096
+
+/* ------------------------------------------------------------------------
+ * the recorded workload: a cache of shared entries, per-request scratch
+ * blocks, a growing response array and the odd large buffer */
+
+static unsigned long long rng_state = 0x9e3779b97f4a7c15ull;
+
+static size_t rng(size_t bound) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (size_t) (rng_state % bound);
+}
+
+static void record_workload(void) {
+    static char *cache[CACHE], *big[8];
+    for (int i = 0; i < CACHE; ++i)
+        cache[i] = shared_arr(char, 32 + rng(224));
+
+    for (int r = 0; r < REQUESTS; ++r) {
+        char *entry = sref(cache[rng(CACHE)]);
+        if (rng(8) == 0) {
+            const size_t i = rng(CACHE);
+            sfree(cache[i]);
+            cache[i] = shared_arr(char, 32 + rng(224));
+        }
+
+        char *temps[TEMPS];
+        for (int i = 0; i < TEMPS; ++i)
+            temps[i] = unique_arr(char, 16 + rng(496));
+
+        char *response = unique_arr(char, 16);
+        for (size_t n = rng(4096); n; --n)
+            arrappend(response, entry[0]);
+
+        if (r % 64 == 0) {
+            sfree(big[r / 64 % 8]);
+            big[r / 64 % 8] = unique_arr(char, 64 * 1024 + rng(192 * 1024));
+        }
+
+        sfree(response);
+        for (int i = 0; i < TEMPS; ++i)
+            sfree(temps[i]);
+        sfree(entry);
+    }
+
+    for (int i = 0; i < 8; ++i)
+        sfree(big[i]);
+    for (int i = 0; i < CACHE; ++i)
+        sfree(cache[i]);
+}
+
+/* ------------------------------------------------------------------------
+ * loading: the traced block addresses become dense slot numbers, so the
+ * timed loop indexes an array instead of probing a map */
+
+typedef struct {
+    uint8_t op;
+    uint32_t slot;
+    size_t size;
+} replay_op;
+
+typedef struct {
+    replay_op *ops;
+    size_t len;
+    size_t slots;
+    size_t peak_live;
+    size_t refs, frees, threads;
+} replay_trace;
+
+typedef struct {
+    uint64_t *keys;
+    uint32_t *vals;
+    size_t mask, len;
+} addr_map;
+
+static size_t map_hash_(uint64_t key) {
+    return (size_t) ((key >> 4) * 0x9e3779b97f4a7c15ull >> 20);
+}
+
+static void map_put_(addr_map *m, uint64_t key, uint32_t val);
+
+static void map_grow_(addr_map *m) {
+    addr_map old = *m;
+    const size_t cap = old.keys ? 2 * (old.mask + 1) : 1024;
+    *m = (addr_map) {
+        .keys = calloc(cap, sizeof *m->keys),
+        .vals = malloc(cap * sizeof *m->vals),
+        .mask = cap - 1,
+    };
+    if (!m->keys || !m->vals) {
+        perror("trace_replay");
+        exit(1);
+    }
+    for (size_t i = 0; old.keys && i <= old.mask; ++i)
+        if (old.keys[i])
+            map_put_(m, old.keys[i], old.vals[i]);
+    free(old.keys);
+    free(old.vals);
+}
+
+static void map_put_(addr_map *m, uint64_t key, uint32_t val) {
+    if (2 * (m->len + 1) > m->mask + 1)
+        map_grow_(m);
+    size_t i = map_hash_(key) & m->mask;
+    while (m->keys[i] && m->keys[i] != key)
+        i = (i + 1) & m->mask;
+    m->len += !m->keys[i];
+    m->keys[i] = key;
+    m->vals[i] = val;
+}
+
+// removes `key`, returning its slot or -1
+static long map_take_(addr_map *m, uint64_t key) {
+    if (!m->keys)
+        return -1;
+    size_t i = map_hash_(key) & m->mask;
+    while (m->keys[i] != key) {
+        if (!m->keys[i])
+            return -1;
+        i = (i + 1) & m->mask;
+    }
+    const long val = m->vals[i];
+    m->keys[i] = 0;
+    --m->len;
+    // shift the rest of the run back over the hole
+    for (size_t j = (i + 1) & m->mask; m->keys[j]; j = (j + 1) & m->mask) {
+        const size_t home = map_hash_(m->keys[j]) & m->mask;
+        if (((j - home) & m->mask) >= ((j - i) & m->mask)) {
+            m->keys[i] = m->keys[j];
+            m->vals[i] = m->vals[j];
+            m->keys[j] = 0;
+            i = j;
+        }
+    }
+    return val;
+}
+
+// realloc for the loader's tables, which it cannot do without
+static void *table_grow_(void *ptr, size_t size) {
+    void *grown = realloc(ptr, size);
+    if (!grown) {
+        perror("trace_replay");
+        exit(1);
+    }
+    return grown;
+}
+
+static int load_trace(const char *path, replay_trace *t) {
+    FILE *in = fopen(path, "rb");
+    if (!in) {
+        perror(path);
+        return -1;
+    }
+    *t = (replay_trace) {0};
+    addr_map live = {0};
+    size_t cap = 0, live_bytes = 0, *sizes = NULL, slot_cap = 0;
+    uint32_t *free_slots = NULL;
+    size_t nfree = 0;
+    csptr_trace_record rec[1024];
+    size_t n;
+
+    while ((n = fread(rec, sizeof *rec, 1024, in)) > 0) {
+        for (size_t i = 0; i < n; ++i) {
+            const csptr_trace_record *r = &rec[i];
+            if (r->thread > t->threads)
+                t->threads = r->thread;
+            if (r->op == CSPTR_TRACE_REF) {
+                t->refs += r->arg;
+                continue;
+            }
+            if (r->op == CSPTR_TRACE_FREE) {
+                t->frees += r->arg;
+                continue;
+            }
+
+            replay_op op = { .op = r->op, .size = (size_t) r->size };
+            long slot = r->op == CSPTR_TRACE_ALLOC ? -1 : map_take_(&live, r->ptr);
+            if (r->op == CSPTR_TRACE_ALLOC) {
+                // reuse released slots so the replay's table stays small
+                slot = nfree ? free_slots[--nfree] : (long) t->slots++;
+                if ((size_t) slot >= slot_cap) {
+                    slot_cap = slot_cap ? 2 * slot_cap : 1024;
+                    sizes = table_grow_(sizes, slot_cap * sizeof *sizes);
+                    free_slots = table_grow_(free_slots, slot_cap * sizeof *free_slots);
+                }
+                sizes[slot] = 0;
+            } else if (slot < 0) {
+                // the block came from before the trace was opened
+                continue;
+            }
+
+            live_bytes -= sizes[slot];
+            if (r->op == CSPTR_TRACE_RELEASE) {
+                sizes[slot] = 0;
+                free_slots[nfree++] = (uint32_t) slot;
+            } else {
+                sizes[slot] = op.size;
+                map_put_(&live, r->op == CSPTR_TRACE_REALLOC ? r->arg : r->ptr, (uint32_t) slot);
+            }
+            live_bytes += sizes[slot];
+            if (live_bytes > t->peak_live)
+                t->peak_live = live_bytes;
+
+            op.slot = (uint32_t) slot;
+            if (t->len == cap) {
+                cap = cap ? 2 * cap : 1 << 16;
+                t->ops = table_grow_(t->ops, cap * sizeof *t->ops);
+            }
+            t->ops[t->len++] = op;
+        }
+    }
+    fclose(in);
+    free(live.keys);
+    free(live.vals);
+    free(sizes);
+    free(free_slots);
+    return 0;
+}
+
+/* ------------------------------------------------------------------------
+ * backends */
+
+/* an arena never gives memory back before sarena_free; the size word in
+ * front of each block is what realloc needs to copy */
+static void *arena_handle_alloc(void *ctx, size_t size) {
+    size_t *p = arena_alloc_(ctx, sizeof (size_t) + size);
+    if (!p)
+        return NULL;
+    *p = size;
+    return p + 1;
+}
+
+static void arena_handle_dealloc(void *ctx, void *ptr) {
+    (void) ctx;
+    (void) ptr;
+}
+
+static void *arena_handle_realloc(void *ctx, void *ptr, size_t size) {
+    void *p = arena_handle_alloc(ctx, size);
+    if (p && ptr) {
+        const size_t old = ((size_t *) ptr)[-1];
+        memcpy(p, ptr, old < size ? old : size);
+    }
+    return p;
+}
+
+/* ------------------------------------------------------------------------
+ * replay */
+
+static size_t rss_now(void) {
+    long pages = 0, resident = 0;
+    FILE *f = fopen("/proc/self/statm", "r");
+    if (f) {
+        if (fscanf(f, "%ld %ld", &pages, &resident) != 2)
+            resident = 0;
+        fclose(f);
+    }
+    return (size_t) resident * (size_t) sysconf(_SC_PAGESIZE);
+}
+
+static size_t rss_peak(void) {
+    char line[128];
+    size_t kib = 0;
+    FILE *f = fopen("/proc/self/status", "r");
+    if (!f)
+        return 0;
+    while (fgets(line, sizeof line, f))
+        if (sscanf(line, "VmHWM: %zu kB", &kib) == 1)
+            break;
+    fclose(f);
+    return kib * 1024;
+}
+
+// fault in every page a block covers, as a program writing to it would
+static void touch(char *p, size_t from, size_t to) {
+    for (size_t off = from & ~(size_t) (PAGE - 1); off < to; off += PAGE)
+        p[off > from ? off : from] = 1;
+}
+
+static void replay(const char *name, const replay_trace *t, const s_alloc_handle *h) {
+    void **blocks = calloc(t->slots, sizeof *blocks);
+    size_t *sizes = calloc(t->slots, sizeof *sizes);
+    if (!blocks || !sizes) {
+        perror("trace_replay");
+        exit(1);
+    }
+    // start from a heap without the parent's leftovers and reset the
+    // high-water mark; clear_refs fails harmlessly on old kernels
+    malloc_trim(0);
+    FILE *clear = fopen("/proc/self/clear_refs", "w");
+    if (clear) {
+        fputs("5", clear);
+        fclose(clear);
+    }
+    const size_t base = rss_now();
+
+    // a failed call leaves the block as it was; later calls on a block that
+    // was never allocated are skipped
+    size_t failed = 0;
+    double t0 = bench_now();
+    for (size_t i = 0; i < t->len; ++i) {
+        const replay_op *op = &t->ops[i];
+        void **b = &blocks[op->slot];
+        void *p;
+        switch (op->op) {
+        case CSPTR_TRACE_ALLOC:
+            if (!(p = h->alloc(h->ctx, op->size))) {
+                ++failed;
+                continue;
+            }
+            touch(p, 0, op->size);
+            *b = p;
+            break;
+        case CSPTR_TRACE_REALLOC:
+            if (!*b)
+                continue;
+            if (!(p = h->realloc(h->ctx, *b, op->size))) {
+                ++failed;
+                continue;
+            }
+            if (op->size > sizes[op->slot])
+                touch(p, sizes[op->slot], op->size);
+            *b = p;
+            break;
+        case CSPTR_TRACE_RELEASE:
+            if (*b)
+                h->dealloc(h->ctx, *b);
+            *b = NULL;
+            break;
+        }
+        sizes[op->slot] = op->size;
+    }
+    const double secs = bench_now() - t0;
+
+    const size_t peak = rss_peak();
+    const size_t grown = peak > base ? peak - base : 0;
+    const double frag = grown > t->peak_live ? 1.0 - (double) t->peak_live / (double) grown : 0;
+    bench_report(name, (double) t->len, secs);
+    printf("%-40s %10.1f MiB peak rss %6.1f%% fragmentation\n", "",
+           (double) grown / (1 << 20), 100 * frag);
+    if (failed)
+        printf("%-40s %10zu allocator calls failed\n", "", failed);
+
+    for (size_t s = 0; s < t->slots; ++s)
+        if (blocks[s])
+            h->dealloc(h->ctx, blocks[s]);
+    free(blocks);
+    free(sizes);
+}
+
+// a NULL handle replays into a fresh arena
+static void run_backend(const char *name, const replay_trace *t, const s_alloc_handle *h) {
+    fflush(stdout);
+    const pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return;
+    }
+    if (pid == 0) {
+        s_alloc_handle arena = {
+            .alloc = arena_handle_alloc,
+            .dealloc = arena_handle_dealloc,
+            .realloc = arena_handle_realloc,
+        };
+        if (!h) {
+            arena.ctx = sarena_new(0);
+            h = &arena;
+        }
+        replay(name, t, h);
+        if (h == &arena)
+            sarena_free(arena.ctx);
+        fflush(stdout);
+        _exit(0);
+    }
+    waitpid(pid, NULL, 0);
+}
+
+int main(int argc, char **argv) {
+    char path[] = "/tmp/csptr_trace_XXXXXX";
+    const char *trace = argc > 1 ? argv[1] : path;
+    if (argc <= 1) {
+        const int fd = mkstemp(path);
+        if (fd < 0 || csptr_trace_open(path)) {
+            perror(path);
+            return 1;
+        }
+        close(fd);
+        // in a child, so the replays don't start on a heap it warmed up
+        fflush(stdout);
+        const pid_t pid = fork();
+        if (pid == 0) {
+            record_workload();
+            csptr_trace_close();
+            _exit(0);
+        }
+        csptr_trace_close();
+        waitpid(pid, NULL, 0);
+    }
+
+    replay_trace t;
+    const int loaded = load_trace(trace, &t);
+    if (argc <= 1)
+        unlink(path);
+    if (loaded)
+        return 1;
+    printf("%zu allocator calls, %zu sref, %zu sfree from %zu thread(s); %.1f MiB peak live\n",
+           t.len, t.refs, t.frees, t.threads, (double) t.peak_live / (1 << 20));
+
+    static const s_alloc_handle malloc_handle = SMALLOC_HANDLE_OF(&smalloc_allocator);
+    run_backend("malloc", &t, &malloc_handle);
+    run_backend("slab pool", &t, &slab_alloc_handle);
+    run_backend("mmap", &t, &mmap_alloc_handle);
+    run_backend("arena (no reuse)", &t, NULL);
+    free(t.ops);
+    return 0;
+}
@@ -0,0 +1,110 @@
+#include "bench.h"
+
+#define MY_LIBCSPTR_IMPLEMENTATION
+#include "../csptr.h"
+
+/* push and iterate throughput: the generic arrappend / arrlenu macros
+ * against the inline functions of CSPTR_DEFINE_VEC.
+ *
+ * This file holds the implementation, so GCC sees through the static_array
+ * table here. Any other translation unit calls it; opaque_ models that for
+ * the arrlenu loop. */
+
+#define ITEMS  (10 * 1000 * 1000)
+#define ROUNDS 5
+
+CSPTR_DEFINE_VEC(ivec, int)
+
+/* iteration runs over a cache-resident array */
+#define ITER_ITEMS  16384
+#define ITER_ROUNDS 5000
+
+static long sink;
+
+static const struct smt_static_array_ns *volatile opaque_ = &static_array;
+
+static double push_generic(int **out) {
+    double secs = 0;
+    for (int r = 0; r < ROUNDS; ++r) {
+        sfree(*out);
+        double t0 = bench_now();
+        int *a = unique_arr(int, 1);
+        for (int i = 0; i < ITEMS; ++i)
+            arrappend(a, i);
+        secs += bench_now() - t0;
+        *out = a;
+    }
+    return secs;
+}
+
+static double push_vec(int **out) {
+    double secs = 0;
+    for (int r = 0; r < ROUNDS; ++r) {
+        sfree(*out);
+        double t0 = bench_now();
+        int *v = NULL;
+        for (int i = 0; i < ITEMS; ++i)
+            ivec_push(&v, i);
+        secs += bench_now() - t0;
+        *out = v;
+    }
+    return secs;
+}
+
+static double iterate_generic(int *a) {
+    double t0 = bench_now();
+    for (int r = 0; r < ITER_ROUNDS; ++r) {
+        long sum = 0;
+        for (size_t i = 0; i < opaque_->length(a); ++i)
+            sum += a[i];
+        sink += sum;
+    }
+    return bench_now() - t0;
+}
+
+static double iterate_vec(int *v) {
+    double t0 = bench_now();
+    for (int r = 0; r < ITER_ROUNDS; ++r) {
+        long sum = 0;
+        for (size_t i = 0; i < ivec_len(v); ++i)
+            sum += *ivec_at(v, i);
+        sink += sum;
+    }
+    return bench_now() - t0;
+}
+
+static double iterate_vec_hoisted(int *v) {
+    double t0 = bench_now();
+    for (int r = 0; r < ITER_ROUNDS; ++r) {
+        long sum = 0;
+        const size_t len = ivec_len(v);
+        for (size_t i = 0; i < len; ++i)
+            sum += *ivec_at(v, i);
+        sink += sum;
+    }
+    return bench_now() - t0;
+}
+
+int main(void) {
+    const double ops = (double) ITEMS * ROUNDS;
+    int *a = NULL, *v = NULL;
+    bench_report("push: arrappend", ops, push_generic(&a));
+    bench_report("push: ivec_push", ops, push_vec(&v));
+    sfree(a);
+    sfree(v);
+
+    a = unique_arr(int, ITER_ITEMS);
+    v = NULL;
+    for (int i = 0; i < ITER_ITEMS; ++i) {
+        arrappend(a, i);
+        ivec_push(&v, i);
+    }
+    const double iter_ops = (double) ITER_ITEMS * ITER_ROUNDS;
+    bench_report("iterate: arrlenu (other TU) + a[i]", iter_ops, iterate_generic(a));
+    bench_report("iterate: ivec_len + ivec_at", iter_ops, iterate_vec(v));
+    bench_report("iterate: ivec_len once + ivec_at", iter_ops, iterate_vec_hoisted(v));
+    bench_escape(&sink);
+    sfree(a);
+    sfree(v);
+    return 0;
+}
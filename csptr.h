@@ -36,23 +36,90 @@
 #  define CSPTR_SENTINEL_DEC int sentinel_;
 # endif
 
+/* CSPTR_COMPACT_HEADER: shrink the per-object header to a single word, with
+ * dtor, allocator and padding stored only when present.
+ * CSPTR_FIXED_HEADER: keep the full header, but at a constant offset before
+ * the payload, so reaching it needs no extra load.
+ * In both modes userdata plus alignment padding must stay under 64 KiB
+ * (smalloc returns NULL past that). Every translation unit must agree on
+ * the setting. */
+
 enum pointer_kind {
     UNIQUE = 1,
     SHARED = 2,
 
-    DYNAMIC_ARRAY = 4
+    DYNAMIC_ARRAY = 4,
+    /* set by smalloc on blocks carved from an s_arena */
+    ARENA = 8,
+    /* the reference count is a plain integer: the object never leaves the
+     * thread that allocated it (asserted in debug builds, except with
+     * CSPTR_COMPACT_HEADER, which has no room for the owner) */
+    LOCAL = 16,
+    SHARED_LOCAL = SHARED | LOCAL,
+    /* biased reference counting: the allocating thread counts without
+     * atomics, other threads use an atomic count merged in later */
+    BIASED = 32,
+    SHARED_BIASED = SHARED | BIASED,
+    /* the last sfree defers destruction until every thread that was inside
+     * sepoch_enter/sepoch_leave at that point has left */
+    EPOCH = 64,
+    SHARED_EPOCH = SHARED | EPOCH,
+    /* set by smalloc on arrays whose dtor slot holds an f_array_destructor */
+    ARRAY_DTOR = 128
 };
 
 typedef void (*f_destructor)(void *, void *);
+/* array destructor, called once for `count` items starting at `base`
+ * instead of once per item. Arrays with neither destructor are trivially
+ * destructible: teardown, arrdel and friends skip them after one test. */
+typedef void (*f_array_destructor)(void *base, size_t count, size_t item_size, void *userdata);
+/* item, ctx */
+typedef int (*f_predicate)(const void *, void *);
 
 typedef struct {
     void *(*alloc)(size_t);
     void (*dealloc)(void *);
     void *(*realloc)(void*, size_t);
+    /* bytes actually usable in a block (e.g. malloc_usable_size);
+     * optional, NULL or 0 means exactly what was asked for */
+    size_t (*usable_size)(void *);
 } s_allocator;
 
 extern s_allocator smalloc_allocator;
 
+/* stateful allocator: every call receives `ctx`. The handle is recorded in
+ * the block header, so it must outlive every object allocated through it. */
+typedef struct {
+    void *(*alloc)(void *ctx, size_t);
+    void (*dealloc)(void *ctx, void *);
+    void *(*realloc)(void *ctx, void*, size_t);
+    void *ctx;
+    /* optional, see s_allocator.usable_size */
+    size_t (*usable_size)(void *ctx, void *);
+} s_alloc_handle;
+
+/* adapters turning a context-free s_allocator (passed as ctx) into a handle */
+void *smalloc_forward_alloc(void *ctx, size_t size);
+void smalloc_forward_dealloc(void *ctx, void *ptr);
+void *smalloc_forward_realloc(void *ctx, void *ptr, size_t size);
+size_t smalloc_forward_usable_size(void *ctx, void *ptr);
+
+# define SMALLOC_HANDLE_OF(Allocator) \
+    { smalloc_forward_alloc, smalloc_forward_dealloc, smalloc_forward_realloc, (void *) (Allocator), \
+      smalloc_forward_usable_size }
+
+/* forwards to whatever smalloc_allocator holds at call time */
+extern const s_alloc_handle smalloc_default_handle;
+
+/* per-thread default used when s_smalloc_args.allocator is NULL;
+ * setting NULL restores smalloc_default_handle. Returns the previous one. */
+const s_alloc_handle *smalloc_get_allocator(void);
+const s_alloc_handle *smalloc_set_allocator(const s_alloc_handle *allocator);
+
+/* bump-pointer region: blocks are only released by sarena_reset/sarena_free,
+ * which run the recorded destructors in allocation order. Not thread-safe. */
+typedef struct s_arena s_arena;
+
 typedef struct {
     CSPTR_SENTINEL_DEC
     size_t item_size;
@@ -65,21 +132,223 @@ typedef struct {
         size_t size;
     } userdata;
     const void* value;
+    s_arena *arena;
+    const s_alloc_handle *allocator;
+    /* payload alignment, a power of two up to SMALLOC_MAX_ALIGNMENT;
+     * 0 keeps the default word alignment */
+    size_t alignment;
+    /* DYNAMIC_ARRAY only, replaces dtor */
+    f_array_destructor array_dtor;
+#ifdef CSPTR_HEAP_PROFILE
+    // call site, filled in by smalloc
+    const char *site_file;
+    const char *site_func;
+    int site_line;
+#endif
 } s_smalloc_args;
 
+#define SMALLOC_MAX_ALIGNMENT 4096
+
 CSPTR_PURE void *get_smart_ptr_userdata(const void * const smart_ptr);
 void *sref(void *ptr);
+/* n references at once, with a single atomic add */
+void *sref_n(void *ptr, size_t n);
 CSPTR_MALLOC_API void *smalloc_impl_(const s_smalloc_args *args);
-void sfree(void *smart_ptr);
+/* inline: dtor-less UNIQUE objects go straight back to their allocator,
+ * everything else through sfree_impl_ */
+static inline void sfree(void *smart_ptr);
+void sfree_impl_(void *smart_ptr);
+/* sfree every pointer of `ptrs` (NULLs allowed); adjacent copies of one
+ * pointer are released with a single atomic, and the dead blocks are
+ * destroyed first and then handed back to their allocators together */
+void sfree_many(void *const *ptrs, size_t count);
 void *smove_size(void *ptr, size_t size);
 
+/* autorelease pools: sautorelease hands `ptr` to the innermost pool of the
+ * calling thread, which releases it together with everything else
+ * registered there, in one sfree_many pass. Every thread has an outermost
+ * pool, drained by csptr_pool_drain only (and never at thread exit);
+ * autorelease_pool opens a nested one that drains at the end of its scope:
+ *
+ *     {
+ *         autorelease_pool;
+ *         route *r = sautorelease(lookup(table, key));
+ *         ...
+ *     }
+ *
+ * sautorelease returns `ptr`, or NULL once it released it when the pool
+ * could not grow. */
+void *sautorelease(void *ptr);
+void csptr_pool_drain(void);
+// autorelease_pool internals: the outer pool, restored on leave
+size_t csptr_pool_enter(void);
+void csptr_pool_leave(size_t *outer);
+
+s_arena *sarena_new(size_t chunk_size);
+void sarena_reset(s_arena *arena);
+void sarena_free(s_arena *arena);
+
+/* weak references to SHARED objects: they keep the block, not the object.
+ * slock returns a new strong reference, or NULL once the destructor ran. */
+typedef struct s_weak s_weak;
+s_weak *sweak(void *ptr);
+void *slock(s_weak *weak);
+void sweak_free(s_weak *weak);
+
+/* epoch read-side critical section, nestable: SHARED_EPOCH objects seen
+ * inside it stay alive until it is left, without sref/sfree */
+void sepoch_enter(void);
+void sepoch_leave(void);
+/* wait until every deferred SHARED_EPOCH object has been destroyed; must
+ * not be called inside a critical section */
+void sepoch_flush(void);
+/* retirements pending before a retire tries to advance the epoch */
+#ifndef SEPOCH_BATCH
+# define SEPOCH_BATCH 64
+#endif
+#ifdef CSPTR_TEST_HOOKS
+/* test-only, for the unit tests: start the global epoch at `epoch`; make
+ * the next `n` limbo node allocations fail */
+void csptr_test_epoch_seed(unsigned epoch);
+void csptr_test_epoch_fail_nodes(int n);
+#endif
+
+#ifndef CSPTR_RECLAIM_QUEUE
+# define CSPTR_RECLAIM_QUEUE 4096
+#endif
+
+/* deferred release, switched per thread: while on, last releases queue the
+ * object for a background reclaimer thread that frees it. SHARED_LOCAL
+ * objects, dtor-less UNIQUE ones and releases that find the queue
+ * (CSPTR_RECLAIM_QUEUE entries) full still run inline. */
+enum csptr_reclaim_mode {
+    CSPTR_RECLAIM_OFF = 0,
+    // only objects without a destructor are deferred
+    CSPTR_RECLAIM_PLAIN = 1,
+    /* destructors run on the reclaimer thread too, so they must not sfree
+     * SHARED_LOCAL objects or use the releasing thread's state */
+    CSPTR_RECLAIM_ALL = 2,
+};
+/* one of enum csptr_reclaim_mode; returns the previous one */
+int csptr_reclaim_defer(int mode);
+/* wait until everything queued so far has been released; call it before
+ * exit. Must not be called from a destructor. */
+void csptr_reclaim_flush(void);
+
+/* merge the SHARED_BIASED objects of the calling thread whose last foreign
+ * reference was dropped elsewhere; also done by the owner's own sfree calls
+ * and at thread exit */
+void sbiased_collect(void);
+
+#ifdef CSPTR_STATS
+#include <stdio.h>
+
+/* CSPTR_STATS: count what smalloc'ed blocks hold, in per-thread shards
+ * summed on read; the inline fast paths update the calling thread's shard
+ * in place. Block sizes are read off the meta data, except for the size of
+ * a single object, which lives in a hidden word in front of every block, so
+ * every translation unit must agree on the setting. Arena blocks are the
+ * arena's and are not counted. */
+enum {
+    CSPTR_STATS_UNIQUE,
+    CSPTR_STATS_SHARED,
+    // unique and shared arrays
+    CSPTR_STATS_ARRAY,
+    CSPTR_STATS_KINDS
+};
+
+typedef struct {
+    size_t objects[CSPTR_STATS_KINDS];  // live blocks
+    size_t bytes[CSPTR_STATS_KINDS];    // their payload
+    size_t header_bytes;    // meta data, userdata and padding of live blocks
+    size_t peak_bytes;      // high-water mark of payload + header bytes
+    size_t array_grows;     // reallocations that grew an array
+    size_t refs;            // references taken by sref / sref_n
+    size_t frees;           // pointers released by sfree / sfree_many
+} csptr_stats;
+
+/* the peak is tracked in CSPTR_STATS_FLUSH steps per thread */
+#ifndef CSPTR_STATS_FLUSH
+# define CSPTR_STATS_FLUSH (64 * 1024)
+#endif
+
+csptr_stats csptr_stats_snapshot(void);
+void csptr_stats_dump(FILE *out);
+#endif /* CSPTR_STATS */
+
+#ifdef CSPTR_HEAP_PROFILE
+#include <stdio.h>
+
+/* CSPTR_HEAP_PROFILE: sample smalloc'ed blocks about once every
+ * CSPTR_HEAP_SAMPLE_RATE allocated bytes (sample points spaced as a
+ * Poisson process over the bytes, like tcmalloc's heap profiler) and keep
+ * the smalloc / smart_ptr / smart_arr call site of each sampled block in a
+ * record out of line. Every block gains a hidden word pointing to its
+ * record, NULL for most, so every translation unit must agree on the
+ * setting. Arena blocks are not sampled; a resized array keeps its sample
+ * and moves its bytes along. */
+#ifndef CSPTR_HEAP_SAMPLE_RATE
+# define CSPTR_HEAP_SAMPLE_RATE (512 * 1024)
+#endif
+
+/* set the mean sampling interval, 1 samples every block; meant for start
+ * up, it restarts the interval of the calling thread only. Returns the
+ * previous rate. */
+size_t csptr_heap_profile_rate(size_t bytes);
+/* the live bytes of the sampled blocks, scaled up to an estimate of all
+ * live bytes, per call site as collapsed stacks: "function;file:line bytes"
+ * lines, as flamegraph.pl and speedscope read them */
+void csptr_heap_profile_dump(FILE *out);
+
+# define SMT_SITE_INIT_ , .site_file = __FILE__, .site_func = __func__, .site_line = __LINE__
+#else
+# define SMT_SITE_INIT_
+#endif /* CSPTR_HEAP_PROFILE */
+
+#ifdef CSPTR_TRACE
+/* CSPTR_TRACE: log every block smalloc hands out, every array reallocation,
+ * sref, sfree and block release to the file opened by csptr_trace_open,
+ * as csptr_trace_record structs in native byte order. Records go through
+ * one lock, so the file is in global order. The inline fast paths are
+ * turned off; arena blocks are left out. bench/trace_replay replays a log
+ * against other allocators. */
+enum csptr_trace_op {
+    CSPTR_TRACE_ALLOC = 1,
+    CSPTR_TRACE_REALLOC,
+    CSPTR_TRACE_REF,
+    CSPTR_TRACE_FREE,
+    // the block went back to its allocator
+    CSPTR_TRACE_RELEASE,
+};
+
+typedef struct {
+    // the block as the allocator returned it; the old one for REALLOC
+    uint64_t ptr;
+    // REALLOC: the new block, REF / FREE: how many references
+    uint64_t arg;
+    // ALLOC / REALLOC: bytes asked of the allocator
+    uint64_t size;
+    // numbered in order of each thread's first record
+    uint32_t thread;
+    uint8_t op;
+    // enum pointer_kind
+    uint8_t kind;
+    uint16_t reserved_;
+} csptr_trace_record;
+
+/* start logging to `path`, truncating it; returns 0 on success */
+int csptr_trace_open(const char *path);
+/* stop logging and close the file */
+void csptr_trace_close(void);
+#endif /* CSPTR_TRACE */
+
 #  define smalloc(...) \
-    smalloc_impl_(&(s_smalloc_args) {CSPTR_SENTINEL __VA_ARGS__ })
+    smalloc_impl_(&(s_smalloc_args) {CSPTR_SENTINEL __VA_ARGS__ SMT_SITE_INIT_})
 
 #  define smove(Ptr) \
     smove_size((Ptr), sizeof (*(Ptr)))
 
-CSPTR_INLINE void sfree_stack(void *ptr) {
+static CSPTR_INLINE void sfree_stack(void *ptr) {
     union {
         void **real_ptr;
         void *ptr;
@@ -90,11 +359,18 @@ CSPTR_INLINE void sfree_stack(void *ptr) {
 }
 
 # define ARGS_ args.dtor, { args.userdata.ptr, args.userdata.size }
+# define ARGS_ALLOC_ args.arena, args.allocator, args.alignment
+// smart_ptr arguments smalloc_fast_ handles, when known at compile time
+# define SMT_FAST_ARGS_(Kind) (((Kind) == UNIQUE || (Kind) == SHARED)      \
+    && !args.userdata.size && !args.arena && !args.allocator && !args.alignment)
 
 #define __MY_PASTE__(A,B) A##B
+#define SMT_PASTE_(A,B) __MY_PASTE__(A,B)
 
 # define autoclean __attribute__ ((cleanup(sfree_stack)))
 # define smart __attribute__ ((cleanup(sfree_stack)))
+# define autorelease_pool __attribute__ ((cleanup(csptr_pool_leave)))      \
+    size_t SMT_PASTE_(smt_pool_, __COUNTER__) = csptr_pool_enter()
 # define smart_ptr(Kind, Type, ...)                                         \
     ({                                                                      \
         struct s_tmp {                                                      \
@@ -105,16 +381,21 @@ CSPTR_INLINE void sfree_stack(void *ptr) {
                 const void *ptr;                                            \
                 size_t size;                                                \
             } userdata;                                                     \
+            s_arena *arena;                                                 \
+            const s_alloc_handle *allocator;                                \
+            size_t alignment;                                               \
         } args = {                                                          \
             CSPTR_SENTINEL                                                  \
             __VA_ARGS__                                                     \
         };                                                                  \
         const __typeof__(Type[1]) dummy;                                    \
         (__typeof__(Type)*)                                                 \
-        (sizeof (dummy[0]) == sizeof (dummy)                                \
-            ? smalloc(sizeof (Type), 1, 1, Kind, ARGS_, &args.value)        \
+        (__builtin_constant_p(SMT_FAST_ARGS_(Kind)) && SMT_FAST_ARGS_(Kind) \
+            ? smalloc_fast_(sizeof (Type), Kind, args.dtor, &args.value)    \
+            : sizeof (dummy[0]) == sizeof (dummy)                           \
+            ? smalloc(sizeof (Type), 1, 1, Kind, ARGS_, &args.value, ARGS_ALLOC_) \
             : smalloc(sizeof (dummy[0]),                                    \
-                sizeof (dummy) / sizeof (dummy[0]), 1, Kind, ARGS_, &args.value));    \
+                sizeof (dummy) / sizeof (dummy[0]), 1, Kind, ARGS_, &args.value, ARGS_ALLOC_)); \
     })
 
 # define smart_arr(Kind, Type, ArrLength, ...)                              \
@@ -127,6 +408,10 @@ CSPTR_INLINE void sfree_stack(void *ptr) {
                 const void *ptr;                                            \
                 size_t size;                                                \
             } userdata;                                                     \
+            s_arena *arena;                                                 \
+            const s_alloc_handle *allocator;                                \
+            size_t alignment;                                               \
+            f_array_destructor array_dtor;                                  \
         } args = {                                                          \
             CSPTR_SENTINEL                                                  \
             __VA_ARGS__                                                     \
@@ -134,14 +419,21 @@ CSPTR_INLINE void sfree_stack(void *ptr) {
         const size_t Cap = ArrLength;                                       \
         const size_t Len = (((args.value) == NULL) ? 0 : ArrLength);        \
         (__typeof__(Type)*)                                                 \
-        smalloc(sizeof(Type), Cap, Len, (Kind | DYNAMIC_ARRAY), ARGS_, args.value); \
+        smalloc(sizeof(Type), Cap, Len, (Kind | DYNAMIC_ARRAY), ARGS_, args.value, ARGS_ALLOC_, \
+                .array_dtor = args.array_dtor);                             \
     })
 
 # define shared_ptr(Type, ...) smart_ptr(SHARED, Type, __VA_ARGS__)
 # define unique_ptr(Type, ...) smart_ptr(UNIQUE, Type, __VA_ARGS__)
+# define shared_local_ptr(Type, ...) smart_ptr(SHARED_LOCAL, Type, __VA_ARGS__)
+# define shared_biased_ptr(Type, ...) smart_ptr(SHARED_BIASED, Type, __VA_ARGS__)
+# define shared_epoch_ptr(Type, ...) smart_ptr(SHARED_EPOCH, Type, __VA_ARGS__)
 
 # define shared_arr(Type, Length, ...) smart_arr(SHARED, Type, Length, __VA_ARGS__)
 # define unique_arr(Type, Length, ...) smart_arr(UNIQUE, Type, Length, __VA_ARGS__)
+# define shared_local_arr(Type, Length, ...) smart_arr(SHARED_LOCAL, Type, Length, __VA_ARGS__)
+# define shared_biased_arr(Type, Length, ...) smart_arr(SHARED_BIASED, Type, Length, __VA_ARGS__)
+# define shared_epoch_arr(Type, Length, ...) smart_arr(SHARED_EPOCH, Type, Length, __VA_ARGS__)
 
 #define arrput smt__arrappend
 #define arrlenu(a) (!(a) ? 0 : static_array.length(a))
@@ -153,12 +445,33 @@ CSPTR_INLINE void sfree_stack(void *ptr) {
 #define arrdeln smt__arrdeln
 #define arrins smt__arrins
 #define arrlast     smt__arrlast
+/* arrdel, arrdeln and arrdelswap run the destructor on the items they drop;
+ * arrpop hands its item back to the caller, so it does not */
+/* O(1) delete: the last item takes the place of item i */
+#define arrdelswap(a,i) smt__arrdelswap(a,i)
+/* drop every item pred(item, ctx) holds for, keeping the order of the rest;
+ * the array's destructor runs on each dropped item. Returns how many. */
+#define arr_remove_if(a,pred,ctx) smt__arrremoveiff_((a), (pred), (ctx))
+/* copy n items from src to the end / to index i, growing at most once;
+ * when that allocation fails, a is left as it was, arrlenu(a) included */
+#define arrappendn(a,src,n)        ((a) = smt__arrinsnf_((a), arrlenu(a), (src), (n)))
+#define arrinsn_values(a,i,src,n)  ((a) = smt__arrinsnf_((a), (i), (src), (n)))
+/* append every item of the smart array b, which holds the same type */
+#define arrextend(a,b)             ((void) (0 ? (a) : (b)), arrappendn(a, b, arrlenu(b)))
+/* grow the capacity to at least n items, without applying the growth policy;
+ * when that allocation fails, a is left as it was, arrcap(a) included */
+#define arrreserve(a,n) ((a) = smt__arrreservef_((a), (n)))
+/* give back the capacity beyond arrlenu(a) */
+#define arrshrink(a)    ((a) = smt__arrshrinkf_(a))
+/* one of enum arr_growth, applied when appends run out of capacity */
+#define arrsetgrowth(a,g) (get_smart_ptr_meta_array_(a)->growth = (g))
 
 #define smt__arrappend(a,v) (smt__arrmaybegrow(a,1), (a)[get_smart_ptr_meta_array_(a)->item_num++] = (v))
 #define smt__arrpop(a) ((a)[--get_smart_ptr_meta_array_(a)->item_num])
 #define smt__arrdel(a,i) smt__arrdeln(a,i,1)
-#define smt__arrdeln(a,i,n)   (memmove(&(a)[i], &(a)[(i)+(n)], get_smart_ptr_meta_array_(a)->item_size * (get_smart_ptr_meta_array_(a)->item_num-(n)-(i))), get_smart_ptr_meta_array_(a)->item_num -= (n))
+#define smt__arrdeln(a,i,n)   (smt_arr_destroy_((a),(i),(n)), memmove(&(a)[i], &(a)[(i)+(n)], get_smart_ptr_meta_array_(a)->item_size * (get_smart_ptr_meta_array_(a)->item_num-(n)-(i))), get_smart_ptr_meta_array_(a)->item_num -= (n))
 #define smt__arrins(a,i,v)    (smt__arrinsn((a),(i),1), (a)[i]=(v))
+#define smt__arrdelswap(a,i)  (smt_arr_destroy_((a),(i),1), (a)[i] = (a)[--get_smart_ptr_meta_array_(a)->item_num])
 
 #define smt__arrmaybegrow(a,n)  ((!(a) || get_smart_ptr_meta_array_(a)->item_num + (n) > get_smart_ptr_meta_array_(a)->item_capacity) \
                                   ? (smt__arrgrow(a,n,0),0) : 0)
@@ -178,293 +491,1713 @@ struct smt_static_array_ns {
 extern const struct smt_static_array_ns static_array;
 extern const struct smt_dynamic_array_ns dynamic_array;
 
+enum arr_growth {
+    ARR_GROW_DOUBLE = 0,
+    ARR_GROW_1_5X,
+    /* doubling, with the block rounded up to SMALLOC_GROW_PAGE_SIZE */
+    ARR_GROW_PAGE,
+    /* just what the append needs; O(n) appends, for arrays that are reserved */
+    ARR_GROW_EXACT
+};
+
+#ifndef SMALLOC_GROW_PAGE_SIZE
+# define SMALLOC_GROW_PAGE_SIZE 4096
+#endif
+
 typedef struct {
     size_t item_num;
     size_t item_size;
     size_t item_capacity;
+    enum arr_growth growth;
 } s_meta_array;
 
 extern s_meta_array *get_smart_ptr_meta_array_(const void * const smart_ptr);
 extern void * smt__arrgrowf_(void *a, size_t addlen, size_t min_cap);
-#endif //MY_LIBCSPTR_H
+extern void * smt__arrshrinkf_(void *a);
+extern void * smt__arrreservef_(void *a, size_t n);
+extern void * smt__arrinsnf_(void *a, size_t i, const void *src, size_t n);
+extern size_t smt__arrremoveiff_(void *a, f_predicate pred, void *ctx);
+extern void smt__arrdestroyf_(void *a, size_t i, size_t n);
+
+/* Block layout, shared by the implementation and the inline fast paths
+ * (CSPTR_DEFINE_VEC); none of it is API. */
 
-#ifdef MY_LIBCSPTR_IMPLEMENTATION
 #ifndef __STDC_NO_ATOMICS__
 #include <stdatomic.h>
 #endif
 
+#ifndef __STDC_NO_ATOMICS__
+typedef volatile atomic_int smt_refcount_;
+#else
+typedef volatile int32_t smt_refcount_;
+#endif
+
+/* one per thread that allocated SHARED_BIASED objects; never freed, so the
+ * address stays a valid owner id after the thread exits */
+typedef struct s_brc_owner_s {
+#ifndef __STDC_NO_ATOMICS__
+    _Atomic(void *) queue;
+#else
+    void *queue;
+#endif
+    // list of exited owners
+    struct s_brc_owner_s *next;
+} s_brc_owner;
+
+/* extra meta of SHARED_BIASED objects; the header's ref_count is the shared
+ * (atomic) count, scaled by BRC_ONE_ with flags in the low bits */
+typedef struct {
+    s_brc_owner *owner;
+    // owner queue link
+    void *next;
+    // owner-only count
+    int32_t biased;
+} s_meta_biased;
+
+#if defined(CSPTR_COMPACT_HEADER) && defined(CSPTR_FIXED_HEADER)
+# error CSPTR_COMPACT_HEADER and CSPTR_FIXED_HEADER are mutually exclusive
+#endif
+
+#ifdef CSPTR_COMPACT_HEADER
+/* Compact layout: one word right before the payload; everything else sits
+ * at negative offsets and is only paid for when used:
+ *
+ *     [pad][userdata][s_meta_array][s_meta_biased][weak][allocator][dtor][word] payload
+ *
+ * weak is a word holding the weak count of SHARED objects. allocator is only
+ * stored when it is not smalloc_default_handle. When there is padding, its
+ * first word holds the padding size. */
+# define CSPTR_ADJACENT_HEADER_
+typedef struct {
+    smt_refcount_ ref_count;
+    uint32_t kind : 8;
+    uint32_t has_dtor : 1;
+    uint32_t has_allocator : 1;
+    uint32_t has_userdata : 1;
+    uint32_t has_pad : 1;
+    uint32_t align_log2 : 4;
+    // distance from the block start to the payload
+    uint32_t offset : 16;
+} s_meta_header;
+
+# define SMT_MAX_OFFSET_ UINT16_MAX
+#elif defined(CSPTR_FIXED_HEADER)
+/* Fixed-offset layout: the full header ends right at the payload, so it is
+ * reached without first loading an offset word:
+ *
+ *     [pad][userdata][s_meta_array][s_meta_biased][header] payload
+ *
+ * When there is padding, its first word holds the padding size. */
+# define CSPTR_ADJACENT_HEADER_
+typedef struct {
+    f_destructor dtor;
+    // NULL for arena blocks
+    const s_alloc_handle *allocator;
+#ifndef NDEBUG
+    void *ptr;
+    // allocating thread of SHARED_LOCAL objects
+    const void *owner;
+#endif /* !NDEBUG */
+    smt_refcount_ ref_count;
+    uint32_t kind : 8;
+    uint32_t has_userdata : 1;
+    uint32_t has_pad : 1;
+    uint32_t align_log2 : 4;
+    // distance from the block start to the payload
+    uint32_t offset : 16;
+    // SHARED only: 1 for all strong references together, plus one per s_weak
+    smt_refcount_ weak_count;
+} s_meta_header;
+
+# define SMT_MAX_OFFSET_ UINT16_MAX
+#else
 typedef struct {
     struct s_meta_header_s {
         enum pointer_kind kind;
+        // payload alignment and the bytes spent reaching it, both fit in
+        // the padding before dtor
+        uint8_t align_log2;
+        uint16_t align_pad;
         f_destructor dtor;
+        // NULL for arena blocks
+        const s_alloc_handle *allocator;
 #ifndef NDEBUG
         void *ptr;
 #endif /* !NDEBUG */
     } header;
-#ifndef __STDC_NO_ATOMICS__
-    volatile atomic_int ref_count;
-#else
-    volatile int32_t ref_count;
-#endif
+    smt_refcount_ ref_count;
+    // 1 for all strong references together, plus one per s_weak
+    smt_refcount_ weak_count;
+#ifndef NDEBUG
+    // allocating thread of SHARED_LOCAL objects
+    const void *owner;
+#endif /* !NDEBUG */
 } s_meta_shared;
 
 typedef struct s_meta_header_s s_meta_header;
+#endif /* !CSPTR_COMPACT_HEADER && !CSPTR_FIXED_HEADER */
+
+static inline size_t get_meta_array_size_(enum pointer_kind kind) {
+//    return kind & DYNAMIC_ARRAY ? sizeof(s_meta_array) : 0;
+    switch (kind & DYNAMIC_ARRAY) {
+        case DYNAMIC_ARRAY:
+            return sizeof(s_meta_array);
+        default:
+            return 0;
+    }
+}
+#ifndef CSPTR_ADJACENT_HEADER_
+static inline size_t get_meta_header_size_(enum pointer_kind kind) {
+    if (kind & BIASED)
+        return sizeof (s_meta_shared) + sizeof (s_meta_biased);
+    return kind & SHARED ? sizeof (s_meta_shared) : sizeof (s_meta_header);
+}
+static inline size_t get_meta_size_(enum pointer_kind kind) {
+    return get_meta_header_size_(kind) + get_meta_array_size_(kind);
+}
+#endif
+
+#if defined(NDEBUG) || defined(CSPTR_COMPACT_HEADER)
+# define smt_check_meta_(Meta, Ptr) ((void) 0)
+# define smt_set_meta_ptr_(Meta, Ptr) ((void) 0)
+#else
+# define smt_check_meta_(Meta, Ptr) assert((Meta)->ptr == (Ptr))
+# define smt_set_meta_ptr_(Meta, Ptr) ((Meta)->ptr = (Ptr))
+#endif
 
 static CSPTR_PURE CSPTR_INLINE s_meta_header *get_smart_ptr_meta_(const void * const smart_ptr) {
+#ifdef CSPTR_ADJACENT_HEADER_
+    return (s_meta_header *) smart_ptr - 1;
+#else
     size_t *sz_ptr = (size_t *) smart_ptr - 1;
     return (s_meta_header *) ((char *) sz_ptr - *sz_ptr);
+#endif
 }
 
-CSPTR_PURE
-s_meta_array *get_smart_ptr_meta_array_(const void * const smart_ptr);
+/* layout accessors: everything below reaches the meta data through these */
 
-CSPTR_PURE
-static size_t array_length_(const void *smart_ptr) {
-    s_meta_array *meta = get_smart_ptr_meta_array_(smart_ptr);
-    return meta ? meta->item_num : 1;  // TODO: instead of 1, it should be real array length
+static CSPTR_INLINE void *meta_raw_(const s_meta_header *meta) {
+#ifdef CSPTR_ADJACENT_HEADER_
+    return (char *) (meta + 1) - meta->offset;
+#else
+    return (void *) meta;
+#endif
 }
 
-CSPTR_PURE
-static size_t array_item_size_(const void *smart_ptr) {
-    s_meta_array *meta = get_smart_ptr_meta_array_(smart_ptr);
-    return meta ? meta->item_size : 0;
+static CSPTR_INLINE size_t meta_align_pad_(const s_meta_header *meta) {
+#ifdef CSPTR_ADJACENT_HEADER_
+    return meta->has_pad ? *(size_t *) meta_raw_(meta) : 0;
+#else
+    return meta->align_pad;
+#endif
 }
 
-CSPTR_PURE
-static size_t array_capacity_(const void *smart_ptr) {
-    s_meta_array *meta = get_smart_ptr_meta_array_(smart_ptr);
-    return meta ? meta->item_capacity : 0;
+static CSPTR_INLINE f_destructor meta_dtor_(const s_meta_header *meta) {
+#ifdef CSPTR_COMPACT_HEADER
+    return meta->has_dtor ? ((const f_destructor *) meta)[-1] : NULL;
+#else
+    return meta->dtor;
+#endif
 }
 
-const struct smt_static_array_ns static_array = {
-        .length = array_length_,
-        .item_size = array_item_size_,
-        .capacity = array_capacity_,
-        .userdata = get_smart_ptr_userdata
-};
-
-static size_t get_smart_ptr_total_meta_sz_(const void* smart_ptr) {
-    return (char*)smart_ptr - ((char*)get_smart_ptr_meta_(smart_ptr));
+static CSPTR_INLINE const s_alloc_handle *meta_allocator_(const s_meta_header *meta) {
+#ifdef CSPTR_COMPACT_HEADER
+    return meta->has_allocator
+        ? ((const s_alloc_handle * const *) meta)[-1 - meta->has_dtor]
+        : &smalloc_default_handle;
+#else
+    return meta->allocator;
+#endif
 }
 
-void *smt__arrgrowf_(void *a, size_t addlen, size_t min_cap) {
-    (void )min_cap;
-    size_t elemsize = array_item_size_(a);
-    size_t min_len = array_length_(a) + addlen;
-    // compute the minimum capacity needed
-    if (min_len > min_cap)
-        min_cap = min_len;
-    if (min_cap <= array_capacity_(a))
-        return a;
-
-    // increase needed capacity to guarantee O(1) amortized
-    if (min_cap < 2 * array_capacity_(a))
-        min_cap = 2 * array_capacity_(a);
-    else if (min_cap < 4)
-        min_cap = 4;
-
-    s_meta_header* raw_a = get_smart_ptr_meta_(a);
-    size_t total_head_meta_userdata_sz = get_smart_ptr_total_meta_sz_(a);
-    // TODO: align memory check
-    void* raw_b = smalloc_allocator.realloc(raw_a, elemsize * min_cap + total_head_meta_userdata_sz);
-    void* b = (char*)raw_b + total_head_meta_userdata_sz;
-#ifndef NDEBUG
-    get_smart_ptr_meta_(b)->ptr = b;
+static CSPTR_INLINE smt_refcount_ *meta_refcount_(s_meta_header *meta) {
+#ifdef CSPTR_ADJACENT_HEADER_
+    return &meta->ref_count;
+#else
+    return &((s_meta_shared *) meta)->ref_count;
 #endif
-    get_smart_ptr_meta_array_(b)->item_capacity = min_cap;
-    return b;
 }
 
-
-static CSPTR_INLINE size_t align(size_t s) {
-    return (s + (sizeof (char *) - 1)) & ~(sizeof (char *) - 1);
+static CSPTR_INLINE smt_refcount_ *meta_weak_count_(s_meta_header *meta) {
+#if defined(CSPTR_COMPACT_HEADER)
+    return (smt_refcount_ *) ((void **) meta - meta->has_dtor - meta->has_allocator - 1);
+#elif defined(CSPTR_FIXED_HEADER)
+    return &meta->weak_count;
+#else
+    return &((s_meta_shared *) meta)->weak_count;
+#endif
 }
 
-s_allocator smalloc_allocator = {malloc, free, realloc};
-
-#ifdef __STDC_NO_ATOMICS__
-#ifdef _MSC_VER
-# include <windows.h>
-# include <malloc.h>
+static CSPTR_INLINE s_meta_biased *meta_biased_(const s_meta_header *meta) {
+#if defined(CSPTR_COMPACT_HEADER)
+    return (s_meta_biased *) ((void **) meta - meta->has_dtor - meta->has_allocator - 1) - 1;
+#elif defined(CSPTR_FIXED_HEADER)
+    return (s_meta_biased *) meta - 1;
+#else
+    return (s_meta_biased *) ((s_meta_shared *) meta + 1);
 #endif
+}
 
-#ifndef _MSC_VER
-static CSPTR_INLINE int32_t atomic_add(volatile int32_t *count, const int32_t limit, const int32_t val) {
-    size_t old_count, new_count;
-    do {
-      old_count = *count;
-      if (old_count == limit)
-          abort();
-      new_count = old_count + val;
-    } while (!__sync_bool_compare_and_swap(count, old_count, new_count));
-    return new_count;
+#ifdef CSPTR_ADJACENT_HEADER_
+// end of userdata / s_meta_array: everything above it up to the header
+static CSPTR_INLINE void **meta_ext_begin_(const s_meta_header *meta) {
+    void **ext = (void **) meta;
+#ifdef CSPTR_COMPACT_HEADER
+    ext -= meta->has_dtor + meta->has_allocator + !!(meta->kind & SHARED);
+#endif
+    if (meta->kind & BIASED)
+        ext -= sizeof (s_meta_biased) / sizeof (void *);
+    return ext;
 }
 #endif
 
-static CSPTR_INLINE int32_t atomic_increment(volatile int32_t *count) {
-#ifdef _MSC_VER
-    return InterlockedIncrement64(count);
+static CSPTR_INLINE s_meta_array *meta_array_(const s_meta_header *meta) {
+    if (!(meta->kind & DYNAMIC_ARRAY))
+        return NULL;
+#ifdef CSPTR_ADJACENT_HEADER_
+    return (s_meta_array *) meta_ext_begin_(meta) - 1;
 #else
-    return atomic_add(count, INT32_MAX, 1);
+    return (s_meta_array *) ((char *) meta + get_meta_header_size_(meta->kind));
 #endif
 }
 
-static CSPTR_INLINE int32_t atomic_decrement(volatile int32_t *count) {
-#ifdef _MSC_VER
-    return InterlockedDecrement64(count);
+static CSPTR_INLINE char *meta_userdata_(const s_meta_header *meta) {
+#ifdef CSPTR_ADJACENT_HEADER_
+    return (char *) meta_raw_(meta) + meta_align_pad_(meta);
 #else
-    return atomic_add(count, 0, -1);
+    return (char *) meta + get_meta_size_(meta->kind);
 #endif
 }
 
+// bytes reserved for userdata, 0 when there is none
+static CSPTR_INLINE size_t meta_userdata_size_(const s_meta_header *meta, const void *smart_ptr) {
+#ifdef CSPTR_ADJACENT_HEADER_
+    (void) smart_ptr;
+    if (!meta->has_userdata)
+        return 0;
+    char *end = meta_array_(meta) ? (char *) meta_array_(meta) : (char *) meta_ext_begin_(meta);
+    return end - meta_userdata_(meta);
 #else
-
-static CSPTR_INLINE int32_t atomic_increment(volatile atomic_int *count) {
-    return atomic_fetch_add(count, 1) + 1;
+    return ((size_t *) smart_ptr)[-1] - meta->align_pad - get_meta_size_(meta->kind);
+#endif
 }
 
-static CSPTR_INLINE int32_t atomic_decrement(volatile atomic_int *count) {
-    return atomic_fetch_sub(count, 1) - 1;
+// destroy items [i, i + n) of a smart array, unless it is trivially destructible
+static CSPTR_INLINE void smt_arr_destroy_(void *a, size_t i, size_t n) {
+    if (n && meta_dtor_(get_smart_ptr_meta_(a)))
+        smt__arrdestroyf_(a, i, n);
 }
 
+#if defined(CSPTR_STATS) || defined(CSPTR_HEAP_PROFILE)
+/* hidden words in front of every block of a stats or profiling build */
+typedef struct {
+#ifdef CSPTR_STATS
+    // payload of a single object, arrays keep theirs in s_meta_array
+    size_t size;
 #endif
+#ifdef CSPTR_HEAP_PROFILE
+    struct s_heap_sample *sample;
+#endif
+} s_block_prefix;
 
-void *sref(void *ptr) {
-    s_meta_header *meta = get_smart_ptr_meta_(ptr);
-    assert(meta->ptr == ptr);
-    assert(meta->kind & SHARED);
-    atomic_increment(&((s_meta_shared *) meta)->ref_count);
-    return ptr;
-}
-
-void *smove_size(void *ptr, size_t size) {
-    s_meta_header *meta = get_smart_ptr_meta_(ptr);
-    assert(meta->kind & UNIQUE);
-
-    s_smalloc_args args;
-
-    size_t *metasize = (size_t *) ptr - 1;
-    if (meta->kind & DYNAMIC_ARRAY) {
-        s_meta_array *arr_meta = get_smart_ptr_meta_array_(ptr);
-        args = (s_smalloc_args) {
-            .item_size = arr_meta->item_size,
-            .item_cap = arr_meta->item_num,
-            .kind = (enum pointer_kind) (SHARED | DYNAMIC_ARRAY),
-            .dtor = meta->dtor,
-            .userdata = { arr_meta, *metasize },    // TODO: Fix it
-        };
-    } else {
-        void *userdata = get_smart_ptr_userdata(ptr);
-        args = (s_smalloc_args) {
-            .item_size = size,
-            .kind = SHARED,
-            .dtor = meta->dtor,
-            .userdata = {userdata, *metasize },
-        };
-    }
+# define SMT_PREFIX_ sizeof (s_block_prefix)
+#else
+# define SMT_PREFIX_ 0
+#endif
 
-    void *newptr = smalloc_impl_(&args);
-    memcpy(newptr, ptr, size);
-    return newptr;
+#ifdef CSPTR_STATS
+#ifdef __STDC_NO_ATOMICS__
+# error CSPTR_STATS needs C11 atomics
+#endif
+/* per-thread counters of CSPTR_STATS, updated inline by the fast paths */
+typedef struct s_stats_shard_s {
+    // owner-written; other threads' frees wrap them, the sums come out right
+    atomic_size_t objects[CSPTR_STATS_KINDS];
+    atomic_size_t bytes[CSPTR_STATS_KINDS];
+    atomic_size_t header_bytes;
+    atomic_size_t array_grows;
+    atomic_size_t refs;
+    atomic_size_t frees;
+    // live bytes not yet added to the global count
+    size_t unflushed;
+    struct s_stats_shard_s *next;
+    atomic_int in_use;
+} s_stats_shard;
+
+// the calling thread's shard, NULL before its first use
+extern _Thread_local s_stats_shard *smt_stats_self_;
+s_stats_shard *smt_stats_shard_(void);
+void smt_stats_flush_(s_stats_shard *shard);
+
+static CSPTR_INLINE void smt_stats_add_(atomic_size_t *counter, size_t n) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + n,
+                          memory_order_relaxed);
 }
 
-CSPTR_MALLOC_API
-CSPTR_INLINE static void *alloc_entry(size_t head, size_t size, size_t metasize) {
-    const size_t totalsize = head + size + metasize + sizeof (size_t);
-#ifdef SMALLOC_FIXED_ALLOCATOR
-    return malloc(totalsize);
-#else /* !SMALLOC_FIXED_ALLOCATOR */
-    return smalloc_allocator.alloc(totalsize);
-#endif /* !SMALLOC_FIXED_ALLOCATOR */
+// a block of `total` bytes, `payload` of them the caller's, now holds `kind`
+static CSPTR_INLINE s_stats_shard *smt_stats_account_(enum pointer_kind kind, intptr_t objects,
+                                                      size_t total, size_t payload) {
+    s_stats_shard *shard = smt_stats_self_;
+    if (!shard && !(shard = smt_stats_shard_()))
+        return NULL;
+    const int k = kind & DYNAMIC_ARRAY ? CSPTR_STATS_ARRAY
+                : kind & SHARED ? CSPTR_STATS_SHARED : CSPTR_STATS_UNIQUE;
+    smt_stats_add_(&shard->objects[k], (size_t) objects);
+    smt_stats_add_(&shard->bytes[k], payload);
+    smt_stats_add_(&shard->header_bytes, total - payload);
+    shard->unflushed += total;
+    if ((intptr_t) shard->unflushed >= CSPTR_STATS_FLUSH || (intptr_t) shard->unflushed <= -CSPTR_STATS_FLUSH)
+        smt_stats_flush_(shard);
+    return shard;
 }
 
-CSPTR_INLINE static void dealloc_entry(s_meta_header *meta, void *ptr) {
-    if (meta->dtor) {
-        void * const userdata = get_smart_ptr_userdata(ptr);
-        if (meta->kind & DYNAMIC_ARRAY) {
-            s_meta_array *arr_meta = get_smart_ptr_meta_array_(ptr);//(void *) (meta + 1);
-            for (size_t i = 0; i < arr_meta->item_num; ++i)
-                meta->dtor((char *) ptr + arr_meta->item_size * i, userdata);
-        }
-        else
-            meta->dtor(ptr, userdata);
-    }
-
-#ifdef SMALLOC_FIXED_ALLOCATOR
-    free(meta);
-#else /* !SMALLOC_FIXED_ALLOCATOR */
-    smalloc_allocator.dealloc(meta);
-#endif /* !SMALLOC_FIXED_ALLOCATOR */
+/* block size of a live smart pointer, read off its meta data: the header up
+ * to the payload, the payload rounded to a word, and the alignment slack
+ * left behind it. smalloc_impl_ allocates exactly that much. */
+static CSPTR_INLINE size_t smt_stats_payload_(const s_meta_header *meta) {
+    const s_meta_array *arr = meta_array_(meta);
+    return arr ? arr->item_size * arr->item_capacity : ((const s_block_prefix *) meta_raw_(meta))[-1].size;
 }
 
-static inline size_t get_meta_header_size_(enum pointer_kind kind) {
-    return kind & SHARED ? sizeof (s_meta_shared) : sizeof (s_meta_header);
-}
-static inline size_t get_meta_array_size_(enum pointer_kind kind) {
-//    return kind & DYNAMIC_ARRAY ? sizeof(s_meta_array) : 0;
-    switch (kind & DYNAMIC_ARRAY) {
-        case DYNAMIC_ARRAY:
-            return sizeof(s_meta_array);
-        default:
-            return 0;
-    }
-}
-static inline size_t get_meta_size_(enum pointer_kind kind) {
-    return get_meta_header_size_(kind) + get_meta_array_size_(kind);
-}
-static inline s_meta_array* get_ptr_meta_array_(const void* raw_ptr, enum pointer_kind kind) {
-    return (s_meta_array*) ((char*)raw_ptr + get_meta_header_size_(kind));
+static CSPTR_INLINE size_t smt_stats_total_(const s_meta_header *meta, const void *ptr, size_t payload) {
+    const size_t slack = ((size_t) 1 << meta->align_log2) - sizeof (char *) - meta_align_pad_(meta);
+    return (size_t) ((const char *) ptr - (const char *) meta_raw_(meta)) + slack
+         + ((payload + sizeof (char *) - 1) & ~(sizeof (char *) - 1));
 }
-static inline char* get_ptr_userdata_(const void* raw_ptr, enum pointer_kind kind) {
-    return (char *) raw_ptr + get_meta_size_(kind);
+
+// the block of `ptr` is about to be freed
+static CSPTR_INLINE s_stats_shard *smt_stats_free_(const s_meta_header *meta, const void *ptr) {
+    const size_t payload = smt_stats_payload_(meta);
+    return smt_stats_account_(meta->kind, -1, -smt_stats_total_(meta, ptr, payload), -payload);
 }
-CSPTR_MALLOC_API
-void *smalloc_impl_(const s_smalloc_args *args) {
-    if (!(args->item_size && args->item_cap))
-        return NULL;
+#endif /* CSPTR_STATS */
+
+/* smalloc_impl_ for the common smart_ptr case, folded at compile time: one
+ * UNIQUE or plain SHARED object of a known size, without userdata, arena,
+ * allocator or alignment. A thread allocator set with smalloc_set_allocator
+ * still goes through smalloc_impl_, and so does a block the heap profiler
+ * is due to sample. */
+extern _Thread_local const s_alloc_handle *smalloc_thread_allocator_;
+
+#ifdef CSPTR_HEAP_PROFILE
+// bytes left before the calling thread's next sample point
+extern _Thread_local intptr_t smt_heap_countdown_;
+#endif
 
-    // align the sizes to the item_size of a word
-    size_t aligned_userdata_size = align(args->userdata.size);
-    size_t rawdata_size = align(args->item_size * args->item_cap);
+#ifdef CSPTR_TRACE
+# define SMT_FAST_SLOW_(Total) 1
+#elif defined(CSPTR_HEAP_PROFILE)
+# define SMT_FAST_SLOW_(Total) (smalloc_thread_allocator_ || smt_heap_countdown_ <= (intptr_t) (Total))
+#else
+# define SMT_FAST_SLOW_(Total) (smalloc_thread_allocator_ != NULL)
+#endif
 
-    const size_t total_meta_size = get_meta_size_(args->kind);
+#ifdef CSPTR_HEAP_PROFILE
+# define SMT_SITE_PARAMS_ , const char *site_file, const char *site_func, int site_line
+# define SMT_SITE_FWD_ , .site_file = site_file, .site_func = site_func, .site_line = site_line
+#else
+# define SMT_SITE_PARAMS_
+# define SMT_SITE_FWD_
+#endif
 
-    void *raw_ptr = alloc_entry(total_meta_size, rawdata_size, aligned_userdata_size);
-    if (raw_ptr == NULL)
+static CSPTR_INLINE void *smalloc_fast_(size_t size, enum pointer_kind kind, f_destructor dtor,
+                                        const void *value SMT_SITE_PARAMS_) {
+    const size_t rawdata_size = (size + sizeof (char *) - 1) & ~(sizeof (char *) - 1);
+#if defined(CSPTR_COMPACT_HEADER)
+    const size_t meta_size = sizeof (s_meta_header) + (dtor ? sizeof (f_destructor) : 0)
+                           + (kind & SHARED ? sizeof (void *) : 0);
+#elif defined(CSPTR_FIXED_HEADER)
+    const size_t meta_size = sizeof (s_meta_header);
+#else
+    const size_t meta_size = (kind & SHARED ? sizeof (s_meta_shared) : sizeof (s_meta_header)) + sizeof (size_t);
+#endif
+    if (SMT_FAST_SLOW_(meta_size + rawdata_size))
+        return smalloc_impl_(&(s_smalloc_args) {CSPTR_SENTINEL size, 1, 1, kind, dtor, .value = value SMT_SITE_FWD_});
+#ifdef CSPTR_HEAP_PROFILE
+    smt_heap_countdown_ -= meta_size + rawdata_size;
+#endif
+#ifdef SMALLOC_FIXED_ALLOCATOR
+    char *raw = malloc(meta_size + rawdata_size + SMT_PREFIX_);
+#else
+    char *raw = smalloc_allocator.alloc(meta_size + rawdata_size + SMT_PREFIX_);
+#endif
+    if (!raw)
         return NULL;
-
-    char * const userdata_ptr = get_ptr_userdata_(raw_ptr, args->kind);
-    if (args->userdata.size && args->userdata.data)
-        memcpy(userdata_ptr, args->userdata.data, args->userdata.size);
-
-    if (args->kind & DYNAMIC_ARRAY) {
-        s_meta_array *meta_array = get_ptr_meta_array_(raw_ptr, args->kind);
-        *meta_array = (s_meta_array) {
-                .item_capacity = args->item_cap,
-                .item_num = args->item_num,
-                .item_size = args->item_size
-        };
-    }
-
-    size_t * const sz_ptr = (size_t *) (userdata_ptr + aligned_userdata_size);
-    *sz_ptr = total_meta_size + aligned_userdata_size;
-
-    *(s_meta_header*) raw_ptr = (s_meta_header) {
-        .kind = args->kind,
-        .dtor = args->dtor,
+    raw += SMT_PREFIX_;
+#ifdef CSPTR_HEAP_PROFILE
+    ((s_block_prefix *) raw)[-1].sample = NULL;
+#endif
+#ifdef CSPTR_STATS
+    ((s_block_prefix *) raw)[-1].size = size;
+    smt_stats_account_(kind, 1, meta_size + rawdata_size, size);
+#endif
+    void *ptr = raw + meta_size;
+
+#if defined(CSPTR_COMPACT_HEADER)
+    s_meta_header *meta = (s_meta_header *) ptr - 1;
+    *meta = (s_meta_header) {
+        .kind = kind,
+        .has_dtor = dtor != NULL,
+        .align_log2 = __builtin_ctzl(sizeof (char *)),
+        .offset = meta_size,
+    };
+    if (dtor)
+        ((f_destructor *) meta)[-1] = dtor;
+#elif defined(CSPTR_FIXED_HEADER)
+    s_meta_header *meta = (s_meta_header *) ptr - 1;
+    *meta = (s_meta_header) {
+        .dtor = dtor,
+        .allocator = &smalloc_default_handle,
 #ifndef NDEBUG
-        .ptr = sz_ptr + 1
+        .ptr = ptr,
 #endif
+        .kind = kind,
+        .align_log2 = __builtin_ctzl(sizeof (char *)),
+        .offset = meta_size,
     };
-
-    if (args->kind & SHARED) {
+#else
+    s_meta_header *meta = (s_meta_header *) raw;
+    ((size_t *) ptr)[-1] = meta_size - sizeof (size_t);
+    *meta = (s_meta_header) {
+        .kind = kind,
+        .align_log2 = (uint8_t) __builtin_ctzl(sizeof (char *)),
+        .dtor = dtor,
+        .allocator = &smalloc_default_handle,
+#ifndef NDEBUG
+        .ptr = ptr
+#endif
+    };
+#endif
+
+    if (kind & SHARED) {
+#ifndef __STDC_NO_ATOMICS__
+        atomic_init(meta_weak_count_(meta), 1);
+        atomic_init(meta_refcount_(meta), 1);
+#else
+        *meta_weak_count_(meta) = 1;
+        *meta_refcount_(meta) = 1;
+#endif
+    }
+    __builtin_memcpy(ptr, value, size);
+    return ptr;
+}
+
+#ifdef CSPTR_HEAP_PROFILE
+// the call site of a smart_ptr is the caller's
+# define smalloc_fast_(Size, Kind, Dtor, Value) \
+    smalloc_fast_((Size), (Kind), (Dtor), (Value), __FILE__, __func__, __LINE__)
+#endif
+
+static CSPTR_INLINE void sfree(void *smart_ptr) {
+#ifndef CSPTR_TRACE
+    if (smart_ptr) {
+        s_meta_header *meta = get_smart_ptr_meta_(smart_ptr);
+        if ((meta->kind & ~DYNAMIC_ARRAY) == UNIQUE && !meta_dtor_(meta)
+#ifdef CSPTR_HEAP_PROFILE
+            && !((s_block_prefix *) meta_raw_(meta))[-1].sample
+#endif
+           ) {
+            smt_check_meta_(meta, smart_ptr);
+#ifdef CSPTR_STATS
+            s_stats_shard *shard = smt_stats_free_(meta, smart_ptr);
+            if (shard)
+                smt_stats_add_(&shard->frees, 1);
+#endif
+            char *head = (char *) meta_raw_(meta) - SMT_PREFIX_;
+#ifdef SMALLOC_FIXED_ALLOCATOR
+            free(head);
+#else
+            const s_alloc_handle *allocator = meta_allocator_(meta);
+            if (allocator == &smalloc_default_handle)
+                smalloc_allocator.dealloc(head);
+            else
+                allocator->dealloc(allocator->ctx, head);
+#endif
+            return;
+        }
+    }
+#endif
+    sfree_impl_(smart_ptr);
+}
+
+/* CSPTR_DEFINE_VEC(name, T) generates a typed, inline front end over smart
+ * arrays of T: the item size is a compile-time constant and the meta data
+ * is reached without a call, so loops over name_len / name_at vectorize.
+ * The arrays are ordinary smart arrays (arrappend, sfree, ... still apply);
+ * a NULL vector is empty and the first push / reserve makes a unique_arr.
+ *
+ *     CSPTR_DEFINE_VEC(ivec, int)
+ *
+ *     smart int *v = NULL;
+ *     ivec_push(&v, 42);
+ *     for (size_t i = 0; i < ivec_len(v); ++i)
+ *         sum += *ivec_at(v, i);
+ *
+ * push and reserve return 0 when the allocation fails, leaving *v as is. */
+static CSPTR_INLINE s_meta_array *smt_vec_meta_(const void *v) {
+    return meta_array_(get_smart_ptr_meta_(v));
+}
+
+#define CSPTR_DEFINE_VEC(name, T)                                           \
+    static inline size_t name##_len(const T *v) {                           \
+        return v ? smt_vec_meta_(v)->item_num : 0;                          \
+    }                                                                       \
+    static inline size_t name##_cap(const T *v) {                           \
+        return v ? smt_vec_meta_(v)->item_capacity : 0;                     \
+    }                                                                       \
+    static inline T *name##_at(T *v, size_t i) {                            \
+        assert(i < name##_len(v));                                          \
+        return v + i;                                                       \
+    }                                                                       \
+    static inline int name##_reserve(T **v, size_t n) {                     \
+        if (!*v) {                                                          \
+            *v = unique_arr(T, n ? n : 1);                                  \
+            return *v != NULL;                                              \
+        }                                                                   \
+        assert(smt_vec_meta_(*v)->item_size == sizeof (T));                 \
+        if (n <= smt_vec_meta_(*v)->item_capacity)                          \
+            return 1;                                                       \
+        T *b = (T *) smt__arrgrowf_(*v, 0, n);                              \
+        if (!b)                                                             \
+            return 0;                                                       \
+        *v = b;                                                             \
+        return 1;                                                           \
+    }                                                                       \
+    static inline int name##_push(T **v, T value) {                         \
+        if (!*v && !name##_reserve(v, 4))                                   \
+            return 0;                                                       \
+        s_meta_array *meta = smt_vec_meta_(*v);                             \
+        assert(meta->item_size == sizeof (T));                              \
+        if (meta->item_num == meta->item_capacity) {                        \
+            T *b = (T *) smt__arrgrowf_(*v, 1, 0);                          \
+            if (!b)                                                         \
+                return 0;                                                   \
+            *v = b;                                                         \
+            meta = smt_vec_meta_(b);                                        \
+        }                                                                   \
+        (*v)[meta->item_num++] = value;                                     \
+        return 1;                                                           \
+    }
+#endif //MY_LIBCSPTR_H
+
+#if defined(MY_LIBCSPTR_IMPLEMENTATION) && !defined(MY_LIBCSPTR_IMPLEMENTED_)
+#define MY_LIBCSPTR_IMPLEMENTED_
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#if defined(NDEBUG) || defined(CSPTR_COMPACT_HEADER)
+# define smt_set_owner_(Meta) ((void) 0)
+# define smt_check_owner_(Meta) ((void) 0)
+#else
+// its address identifies the calling thread
+static _Thread_local char smt_thread_tag_;
+# ifdef CSPTR_FIXED_HEADER
+#  define smt_owner_(Meta) ((Meta)->owner)
+# else
+#  define smt_owner_(Meta) (((s_meta_shared *) (Meta))->owner)
+# endif
+# define smt_set_owner_(Meta) (smt_owner_(Meta) = &smt_thread_tag_)
+# define smt_check_owner_(Meta) \
+    assert(smt_owner_(Meta) == &smt_thread_tag_ && "SHARED_LOCAL object used from another thread")
+#endif
+
+#ifdef CSPTR_STATS
+#include <pthread.h>
+
+static struct {
+    _Atomic(s_stats_shard *) shards;
+    atomic_size_t live;
+    atomic_size_t peak;
+    pthread_once_t once;
+    pthread_key_t key;
+} stats_ = {
+    .once = PTHREAD_ONCE_INIT,
+};
+
+_Thread_local s_stats_shard *smt_stats_self_;
+
+void smt_stats_flush_(s_stats_shard *shard) {
+    const size_t live = atomic_fetch_add(&stats_.live, shard->unflushed) + shard->unflushed;
+    shard->unflushed = 0;
+    size_t peak = atomic_load(&stats_.peak);
+    while ((ptrdiff_t) live > (ptrdiff_t) peak
+           && !atomic_compare_exchange_weak(&stats_.peak, &peak, live))
+        ;
+}
+
+static void stats_thread_exit_(void *shard) {
+    smt_stats_flush_(shard);
+    smt_stats_self_ = NULL;
+    atomic_store(&((s_stats_shard *) shard)->in_use, 0);
+}
+
+static void stats_make_key_(void) {
+    pthread_key_create(&stats_.key, stats_thread_exit_);
+}
+
+// the calling thread's shard: a free one left by an exited thread, or a new one
+s_stats_shard *smt_stats_shard_(void) {
+    if (smt_stats_self_)
+        return smt_stats_self_;
+    pthread_once(&stats_.once, stats_make_key_);
+    s_stats_shard *shard;
+    for (shard = atomic_load(&stats_.shards); shard; shard = shard->next) {
+        int idle = 0;
+        if (atomic_compare_exchange_strong(&shard->in_use, &idle, 1))
+            break;
+    }
+    if (!shard) {
+        if (!(shard = calloc(1, sizeof (s_stats_shard))))
+            return NULL;
+        atomic_init(&shard->in_use, 1);
+        shard->next = atomic_load(&stats_.shards);
+        while (!atomic_compare_exchange_weak(&stats_.shards, &shard->next, shard))
+            ;
+    }
+    pthread_setspecific(stats_.key, shard);
+    return smt_stats_self_ = shard;
+}
+
+// a new block of `total` bytes with a payload of `payload`
+static void stats_alloc_(void *raw_ptr, enum pointer_kind kind, size_t total, size_t payload) {
+    ((s_block_prefix *) raw_ptr)[-1].size = payload;
+    smt_stats_account_(kind, 1, total, payload);
+}
+
+// a resized array went from `before` to `after` payload bytes; the rest of
+// the block keeps its size
+static void stats_resize_(enum pointer_kind kind, size_t before, size_t after, int grow) {
+    const size_t mask = sizeof (char *) - 1;
+    s_stats_shard *shard = smt_stats_account_(kind, 0, ((after + mask) & ~mask) - ((before + mask) & ~mask),
+                                              after - before);
+    if (grow && shard)
+        smt_stats_add_(&shard->array_grows, 1);
+}
+
+static void stats_ref_(size_t n) {
+    s_stats_shard *shard = smt_stats_shard_();
+    if (shard)
+        smt_stats_add_(&shard->refs, n);
+}
+
+static void stats_frees_(size_t n) {
+    s_stats_shard *shard = smt_stats_shard_();
+    if (shard)
+        smt_stats_add_(&shard->frees, n);
+}
+
+# define stats_free_(Meta, Ptr) smt_stats_free_((Meta), (Ptr))
+
+csptr_stats csptr_stats_snapshot(void) {
+    csptr_stats stats = {0};
+    for (s_stats_shard *shard = atomic_load(&stats_.shards); shard; shard = shard->next) {
+        for (int k = 0; k < CSPTR_STATS_KINDS; ++k) {
+            stats.objects[k] += atomic_load_explicit(&shard->objects[k], memory_order_relaxed);
+            stats.bytes[k] += atomic_load_explicit(&shard->bytes[k], memory_order_relaxed);
+        }
+        stats.header_bytes += atomic_load_explicit(&shard->header_bytes, memory_order_relaxed);
+        stats.array_grows += atomic_load_explicit(&shard->array_grows, memory_order_relaxed);
+        stats.refs += atomic_load_explicit(&shard->refs, memory_order_relaxed);
+        stats.frees += atomic_load_explicit(&shard->frees, memory_order_relaxed);
+    }
+    size_t live = stats.header_bytes;
+    for (int k = 0; k < CSPTR_STATS_KINDS; ++k)
+        live += stats.bytes[k];
+    const size_t peak = atomic_load(&stats_.peak);
+    stats.peak_bytes = live > peak ? live : peak;
+    return stats;
+}
+
+void csptr_stats_dump(FILE *out) {
+    static const char *const names[CSPTR_STATS_KINDS] = {"unique", "shared", "array"};
+    const csptr_stats stats = csptr_stats_snapshot();
+    fprintf(out, "%-8s %12s %14s\n", "kind", "objects", "bytes");
+    for (int k = 0; k < CSPTR_STATS_KINDS; ++k)
+        fprintf(out, "%-8s %12zu %14zu\n", names[k], stats.objects[k], stats.bytes[k]);
+    fprintf(out, "header bytes %zu\n", stats.header_bytes);
+    fprintf(out, "peak bytes   %zu\n", stats.peak_bytes);
+    fprintf(out, "array grows  %zu\n", stats.array_grows);
+    fprintf(out, "sref         %zu\n", stats.refs);
+    fprintf(out, "sfree        %zu\n", stats.frees);
+}
+#else
+# define stats_alloc_(Raw, Kind, Total, Payload) ((void) 0)
+# define stats_free_(Meta, Ptr) ((void) (Ptr))
+# define stats_resize_(Kind, Before, After, Grow) ((void) (Before))
+# define stats_ref_(N) ((void) 0)
+# define stats_frees_(N) ((void) 0)
+#endif /* CSPTR_STATS */
+
+#ifdef CSPTR_HEAP_PROFILE
+#ifdef __STDC_NO_ATOMICS__
+# error CSPTR_HEAP_PROFILE needs C11 atomics
+#endif
+#include <pthread.h>
+
+typedef struct s_heap_site {
+    const char *file;
+    const char *func;
+    int line;
+    // estimates for all blocks, sampled or not
+    double live_bytes;
+    double live_objects;
+    struct s_heap_site *next;
+} s_heap_site;
+
+struct s_heap_sample {
+    s_heap_site *site;
+    size_t size;
+    // 1 / P(a block of `size` bytes is sampled)
+    double scale;
+};
+
+#define HEAP_SITE_BUCKETS_ 1024
+
+static struct {
+    pthread_mutex_t lock;
+    s_heap_site *sites[HEAP_SITE_BUCKETS_];
+    // read by every thread's sampler, without the lock
+    atomic_size_t rate;
+} heap_ = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .rate = CSPTR_HEAP_SAMPLE_RATE,
+};
+
+_Thread_local intptr_t smt_heap_countdown_;
+// xorshift state, 0 until the first interval is drawn
+static _Thread_local uint64_t heap_rng_;
+
+// -ln(u) for u in (0, 1], without libm: u = m * 2^e, then an atanh series for ln(m)
+static double heap_neg_log_(double u) {
+    union { double d; uint64_t bits; } v = { u };
+    const int e = (int) ((v.bits >> 52) & 0x7ff) - 1023;
+    v.bits = (v.bits & ~((uint64_t) 0x7ff << 52)) | ((uint64_t) 1023 << 52);
+    const double t = (v.d - 1) / (v.d + 1), t2 = t * t;
+    const double ln_m = 2 * t * (1 + t2 * (1.0 / 3 + t2 * (1.0 / 5 + t2 * (1.0 / 7 + t2 / 9))));
+    return -(e * 0.6931471805599453 + ln_m);
+}
+
+// e^-x for x >= 0: a Taylor polynomial on x / 2^k, squared k times
+static double heap_exp_neg_(double x) {
+    if (x > 700)
+        return 0;
+    int k = 0;
+    for (; x > 0.5; x /= 2)
+        ++k;
+    double r = 1 - x * (1 - x / 2 * (1 - x / 3 * (1 - x / 4 * (1 - x / 5 * (1 - x / 6)))));
+    while (k--)
+        r *= r;
+    return r;
+}
+
+// the distance to the next sample point, exponentially distributed
+static void heap_draw_(void) {
+    if (!heap_rng_)
+        heap_rng_ = ((uintptr_t) &heap_rng_ ^ 0x9e3779b97f4a7c15u) | 1;
+    heap_rng_ ^= heap_rng_ >> 12;
+    heap_rng_ ^= heap_rng_ << 25;
+    heap_rng_ ^= heap_rng_ >> 27;
+    const double u = (double) (((heap_rng_ * 0x2545f4914f6cdd1du) >> 11) + 1) * 0x1p-53;
+    const size_t rate = atomic_load_explicit(&heap_.rate, memory_order_relaxed);
+    smt_heap_countdown_ = (intptr_t) (heap_neg_log_(u) * (double) rate) + 1;
+}
+
+size_t csptr_heap_profile_rate(size_t bytes) {
+    const size_t prev = atomic_exchange_explicit(&heap_.rate, bytes ? bytes : 1, memory_order_relaxed);
+    heap_draw_();
+    return prev;
+}
+
+/* under heap_.lock. Sites are keyed by the contents of __FILE__: a call
+ * site in a header has one copy of the string per translation unit. */
+static s_heap_site *heap_site_(const char *file, const char *func, int line) {
+    size_t hash = (uintptr_t) line * 2654435761u;
+    for (const char *c = file ? file : ""; *c; ++c)
+        hash = (hash ^ (unsigned char) *c) * 1099511628211u;
+    s_heap_site **bucket = &heap_.sites[hash % HEAP_SITE_BUCKETS_];
+    for (s_heap_site *site = *bucket; site; site = site->next)
+        if (site->line == line && (site->file == file || (site->file && file && !strcmp(site->file, file))))
+            return site;
+    s_heap_site *site = calloc(1, sizeof (s_heap_site));
+    if (!site)
+        return NULL;
+    site->file = file;
+    site->func = func;
+    site->line = line;
+    site->next = *bucket;
+    return *bucket = site;
+}
+
+// a new block of `size` bytes: sample it when a sample point falls inside
+static void heap_alloc_(void *raw_ptr, size_t size, const s_smalloc_args *args) {
+    s_block_prefix *prefix = (s_block_prefix *) raw_ptr - 1;
+    prefix->sample = NULL;
+    if (!heap_rng_)
+        heap_draw_();
+    if ((smt_heap_countdown_ -= (intptr_t) size) > 0)
+        return;
+    heap_draw_();
+
+    struct s_heap_sample *sample = malloc(sizeof (struct s_heap_sample));
+    if (!sample)
+        return;
+    sample->size = size;
+    const size_t rate = atomic_load_explicit(&heap_.rate, memory_order_relaxed);
+    sample->scale = 1 / (1 - heap_exp_neg_((double) size / (double) rate));
+    pthread_mutex_lock(&heap_.lock);
+    sample->site = heap_site_(args->site_file, args->site_func, args->site_line);
+    if (sample->site) {
+        sample->site->live_bytes += (double) size * sample->scale;
+        sample->site->live_objects += sample->scale;
+    }
+    pthread_mutex_unlock(&heap_.lock);
+    if (!sample->site) {
+        free(sample);
+        return;
+    }
+    prefix->sample = sample;
+}
+
+static void heap_free_(const s_meta_header *meta) {
+    struct s_heap_sample *sample = ((s_block_prefix *) meta_raw_(meta) - 1)->sample;
+    if (!sample)
+        return;
+    pthread_mutex_lock(&heap_.lock);
+    sample->site->live_bytes -= (double) sample->size * sample->scale;
+    sample->site->live_objects -= sample->scale;
+    pthread_mutex_unlock(&heap_.lock);
+    free(sample);
+}
+
+static void heap_resize_(void *raw_ptr, size_t size) {
+    struct s_heap_sample *sample = ((s_block_prefix *) raw_ptr - 1)->sample;
+    if (!sample)
+        return;
+    pthread_mutex_lock(&heap_.lock);
+    sample->site->live_bytes += ((double) size - (double) sample->size) * sample->scale;
+    sample->size = size;
+    pthread_mutex_unlock(&heap_.lock);
+}
+
+void csptr_heap_profile_dump(FILE *out) {
+    pthread_mutex_lock(&heap_.lock);
+    for (size_t i = 0; i < HEAP_SITE_BUCKETS_; ++i) {
+        for (s_heap_site *site = heap_.sites[i]; site; site = site->next) {
+            if (site->live_bytes < 0.5)
+                continue;
+            fprintf(out, "%s;%s:%d %.0f\n", site->func ? site->func : "?",
+                    site->file ? site->file : "?", site->line, site->live_bytes);
+        }
+    }
+    pthread_mutex_unlock(&heap_.lock);
+}
+#else
+# define heap_alloc_(Raw, Size, Args) ((void) 0)
+# define heap_free_(Meta) ((void) 0)
+# define heap_resize_(Raw, Size) ((void) 0)
+#endif /* CSPTR_HEAP_PROFILE */
+
+#ifdef CSPTR_TRACE
+#include <pthread.h>
+#include <stdio.h>
+
+static struct {
+    pthread_mutex_t lock;
+    FILE *out;
+    uint32_t threads;
+} trace_log_ = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+};
+
+// 0 until the thread's first record
+static _Thread_local uint32_t trace_thread_;
+
+static void trace_(enum csptr_trace_op op, const void *ptr, uint64_t arg, size_t size, unsigned kind) {
+    pthread_mutex_lock(&trace_log_.lock);
+    if (trace_log_.out) {
+        if (!trace_thread_)
+            trace_thread_ = ++trace_log_.threads;
+        const csptr_trace_record record = {
+            .ptr = (uintptr_t) ptr,
+            .arg = arg,
+            .size = size,
+            .thread = trace_thread_,
+            .op = (uint8_t) op,
+            .kind = (uint8_t) kind,
+        };
+        fwrite(&record, sizeof record, 1, trace_log_.out);
+    }
+    pthread_mutex_unlock(&trace_log_.lock);
+}
+
+// the block the allocator handed out for `meta`
+static CSPTR_INLINE void *trace_head_(const s_meta_header *meta) {
+    return (char *) meta_raw_(meta) - SMT_PREFIX_;
+}
+
+int csptr_trace_open(const char *path) {
+    FILE *out = fopen(path, "wb");
+    if (!out)
+        return -1;
+    pthread_mutex_lock(&trace_log_.lock);
+    FILE *prev = trace_log_.out;
+    trace_log_.out = out;
+    pthread_mutex_unlock(&trace_log_.lock);
+    if (prev)
+        fclose(prev);
+    return 0;
+}
+
+void csptr_trace_close(void) {
+    pthread_mutex_lock(&trace_log_.lock);
+    FILE *out = trace_log_.out;
+    trace_log_.out = NULL;
+    pthread_mutex_unlock(&trace_log_.lock);
+    if (out)
+        fclose(out);
+}
+#else
+# define trace_(Op, Ptr, Arg, Size, Kind) ((void) 0)
+#endif /* CSPTR_TRACE */
+
+
+CSPTR_PURE
+s_meta_array *get_smart_ptr_meta_array_(const void * const smart_ptr);
+
+CSPTR_PURE
+static size_t array_length_(const void *smart_ptr) {
+    s_meta_array *meta = get_smart_ptr_meta_array_(smart_ptr);
+    return meta ? meta->item_num : 1;  // TODO: instead of 1, it should be real array length
+}
+
+CSPTR_PURE
+static size_t array_item_size_(const void *smart_ptr) {
+    s_meta_array *meta = get_smart_ptr_meta_array_(smart_ptr);
+    return meta ? meta->item_size : 0;
+}
+
+CSPTR_PURE
+static size_t array_capacity_(const void *smart_ptr) {
+    s_meta_array *meta = get_smart_ptr_meta_array_(smart_ptr);
+    return meta ? meta->item_capacity : 0;
+}
+
+const struct smt_static_array_ns static_array = {
+        .length = array_length_,
+        .item_size = array_item_size_,
+        .capacity = array_capacity_,
+        .userdata = get_smart_ptr_userdata
+};
+
+static CSPTR_INLINE size_t align(size_t s) {
+    return (s + (sizeof (char *) - 1)) & ~(sizeof (char *) - 1);
+}
+
+static CSPTR_INLINE size_t align_to_(size_t s, size_t alignment) {
+    return (s + (alignment - 1)) & ~(alignment - 1);
+}
+
+static size_t get_smart_ptr_total_meta_sz_(const void* smart_ptr) {
+    return (char*)smart_ptr - (char*)meta_raw_(get_smart_ptr_meta_(smart_ptr));
+}
+
+typedef struct s_arena_chunk_s {
+    struct s_arena_chunk_s *next;
+    size_t size;
+    size_t used;
+} s_arena_chunk;
+
+/* destructor record, chained in allocation order so sarena_reset can run them */
+typedef struct s_arena_dtor_s {
+    struct s_arena_dtor_s *next;
+    void *ptr;
+} s_arena_dtor;
+
+/* prefix of every arena block */
+typedef struct {
+    s_arena *arena;
+    s_arena_dtor *dtor;
+} s_arena_block;
+
+struct s_arena {
+    const s_alloc_handle *allocator;
+    s_arena_chunk *chunk;
+    size_t chunk_size;
+    s_arena_dtor *dtors;
+    s_arena_dtor **dtors_tail;
+};
+
+static CSPTR_INLINE s_arena_block *arena_block_of_(void *raw_ptr) {
+    return (s_arena_block *) raw_ptr - 1;
+}
+
+static void *arena_bump_(s_arena *arena, size_t size);
+static void *arena_alloc_(s_arena *arena, size_t size);
+static void *arena_realloc_(void *raw_ptr, size_t old_size, size_t new_size);
+static void destroy_items_(const s_meta_header *meta, f_destructor dtor, char *base,
+                           size_t count, size_t item_size, void *userdata);
+
+/* move `a` into a block for `cap` items. When `grow`, slack the allocator
+ * handed out beyond the request is counted as capacity as well. */
+static void *arr_resize_(void *a, size_t cap, int grow) {
+    size_t elemsize = array_item_size_(a);
+    s_meta_header* meta_a = get_smart_ptr_meta_(a);
+    void* raw_a = meta_raw_(meta_a);
+    size_t total_head_meta_userdata_sz = get_smart_ptr_total_meta_sz_(a);
+    const size_t item_num = array_length_(a);
+    const size_t alignment = (size_t) 1 << meta_a->align_log2;
+    const size_t align_pad = meta_align_pad_(meta_a);
+    const size_t payload_a = elemsize * array_capacity_(a);
+    // the new block may land on a different alignment: reserve the worst case
+    size_t new_size = elemsize * cap + total_head_meta_userdata_sz - align_pad
+                    + alignment - sizeof (char *);
+    if (grow && get_smart_ptr_meta_array_(a)->growth == ARR_GROW_PAGE) {
+        new_size = align_to_(new_size, SMALLOC_GROW_PAGE_SIZE);
+        cap = (new_size - (total_head_meta_userdata_sz - align_pad + alignment - sizeof (char *))) / elemsize;
+    }
+    void* raw_b;
+    char *head_a = (char *) raw_a - SMT_PREFIX_;
+    size_t usable = 0;
+    if (meta_a->kind & ARENA) {
+        raw_b = arena_realloc_(raw_a, elemsize * item_num + total_head_meta_userdata_sz, new_size);
+        // the destructor record keeps its place in the chain
+        if (raw_b && arena_block_of_(raw_b)->dtor)
+            arena_block_of_(raw_b)->dtor->ptr = (char*)raw_b + total_head_meta_userdata_sz;
+    } else {
+        char *head_b;
+#ifdef SMALLOC_FIXED_ALLOCATOR
+        head_b = realloc(head_a, new_size + SMT_PREFIX_);
+# ifdef __GLIBC__
+        if (head_b && grow)
+            usable = malloc_usable_size(head_b);
+# endif
+#else /* !SMALLOC_FIXED_ALLOCATOR */
+        const s_alloc_handle *allocator = meta_allocator_(meta_a);
+        head_b = allocator->realloc(allocator->ctx, head_a, new_size + SMT_PREFIX_);
+        if (head_b && grow && allocator->usable_size)
+            usable = allocator->usable_size(allocator->ctx, head_b);
+#endif /* !SMALLOC_FIXED_ALLOCATOR */
+        raw_b = head_b ? head_b + SMT_PREFIX_ : NULL;
+        usable = usable > SMT_PREFIX_ ? usable - SMT_PREFIX_ : 0;
+    }
+    if (raw_b == NULL)
+        return NULL;
+    void* b = (char*)raw_b + total_head_meta_userdata_sz;
+
+    char *meta_end = (char *) b - align_pad;
+    char *aligned_b = (char *) align_to_((size_t) meta_end, alignment);
+    if (aligned_b != b) {
+        const size_t new_pad = aligned_b - meta_end;
+#ifdef CSPTR_ADJACENT_HEADER_
+        // the padding leads the block: slide userdata, meta and payload together
+        memmove((char *) raw_b + new_pad, (char *) raw_b + align_pad,
+                total_head_meta_userdata_sz - align_pad + elemsize * item_num);
+        s_meta_header *meta_b = (s_meta_header *) aligned_b - 1;
+        meta_b->offset = aligned_b - (char *) raw_b;
+        meta_b->has_pad = new_pad != 0;
+        if (new_pad)
+            *(size_t *) raw_b = new_pad;
+#else
+        memmove(aligned_b, b, elemsize * item_num);
+        s_meta_header *meta_b = raw_b;
+        meta_b->align_pad = (uint16_t) new_pad;
+        ((size_t *) aligned_b)[-1] = aligned_b - sizeof (size_t) - (char *) raw_b;
+#endif
+        b = aligned_b;
+        if (meta_b->kind & ARENA && arena_block_of_(raw_b)->dtor)
+            arena_block_of_(raw_b)->dtor->ptr = b;
+    }
+    smt_set_meta_ptr_(get_smart_ptr_meta_(b), b);
+    const size_t used = (char *) b - (char *) raw_b;
+    if (usable > used && (usable - used) / elemsize > cap)
+        cap = (usable - used) / elemsize;
+    get_smart_ptr_meta_array_(b)->item_capacity = cap;
+    const s_meta_header *meta_b = get_smart_ptr_meta_(b);
+    if (!(meta_b->kind & ARENA)) {
+        stats_resize_(meta_b->kind, payload_a, elemsize * cap, grow);
+        heap_resize_(raw_b, new_size);
+        trace_(CSPTR_TRACE_REALLOC, head_a, (uintptr_t) raw_b - SMT_PREFIX_, new_size + SMT_PREFIX_, meta_b->kind);
+    }
+    return b;
+}
+
+void *smt__arrgrowf_(void *a, size_t addlen, size_t min_cap) {
+    const size_t cap = array_capacity_(a);
+    size_t min_len = array_length_(a) + addlen;
+    // compute the minimum capacity needed
+    if (min_len > min_cap)
+        min_cap = min_len;
+    if (min_cap <= cap)
+        return a;
+
+    // arrreserve asks for an exact capacity; appends follow the policy
+    if (addlen) {
+        switch (get_smart_ptr_meta_array_(a)->growth) {
+            case ARR_GROW_EXACT:
+                break;
+            case ARR_GROW_1_5X:
+                if (min_cap < cap + cap / 2)
+                    min_cap = cap + cap / 2;
+                else if (min_cap < 4)
+                    min_cap = 4;
+                break;
+            case ARR_GROW_DOUBLE:
+            case ARR_GROW_PAGE:
+            default:
+                // increase needed capacity to guarantee O(1) amortized
+                if (min_cap < 2 * cap)
+                    min_cap = 2 * cap;
+                else if (min_cap < 4)
+                    min_cap = 4;
+                break;
+        }
+    }
+    return arr_resize_(a, min_cap, 1);
+}
+
+void *smt__arrreservef_(void *a, size_t n) {
+    void *b = smt__arrgrowf_(a, 0, n);
+    return b ? b : a;
+}
+
+void *smt__arrinsnf_(void *a, size_t i, const void *src, size_t n) {
+    if (!n)
+        return a;
+    const size_t elemsize = array_item_size_(a);
+    const size_t len = array_length_(a);
+    // src may point into a itself, which may move when growing
+    const size_t alias = (const char *) src >= (char *) a && (const char *) src < (char *) a + elemsize * len
+                       ? (size_t) ((const char *) src - (char *) a) / elemsize : SIZE_MAX;
+    void *b = smt__arrgrowf_(a, n, 0);
+    if (!b)
+        return a;
+    char *base = b;
+    memmove(base + elemsize * (i + n), base + elemsize * i, elemsize * (len - i));
+    if (alias == SIZE_MAX) {
+        memcpy(base + elemsize * i, src, elemsize * n);
+    } else {
+        // the source items from i on were just shifted up by n
+        const size_t before = alias < i ? (i - alias < n ? i - alias : n) : 0;
+        memcpy(base + elemsize * i, base + elemsize * alias, elemsize * before);
+        memcpy(base + elemsize * (i + before), base + elemsize * (alias + before + n), elemsize * (n - before));
+    }
+    get_smart_ptr_meta_array_(b)->item_num = len + n;
+    return b;
+}
+
+size_t smt__arrremoveiff_(void *a, f_predicate pred, void *ctx) {
+    if (!a)
+        return 0;
+    s_meta_array *arr_meta = get_smart_ptr_meta_array_(a);
+    const size_t elemsize = arr_meta->item_size;
+    const size_t len = arr_meta->item_num;
+    const s_meta_header *meta = get_smart_ptr_meta_(a);
+    const f_destructor dtor = meta_dtor_(meta);
+    void * const userdata = dtor ? get_smart_ptr_userdata(a) : NULL;
+    char * const base = a;
+
+    // kept items move down a run at a time
+    size_t kept = 0, run = 0;
+    for (size_t i = 0; i < len; ++i) {
+        char *item = base + elemsize * i;
+        if (!pred(item, ctx))
+            continue;
+        if (dtor)
+            destroy_items_(meta, dtor, item, 1, elemsize, userdata);
+        if (run != kept)
+            memmove(base + elemsize * kept, base + elemsize * run, elemsize * (i - run));
+        kept += i - run;
+        run = i + 1;
+    }
+    if (run != kept)
+        memmove(base + elemsize * kept, base + elemsize * run, elemsize * (len - run));
+    kept += len - run;
+    arr_meta->item_num = kept;
+    return len - kept;
+}
+
+void *smt__arrshrinkf_(void *a) {
+    if (get_smart_ptr_meta_(a)->kind & ARENA || array_capacity_(a) <= array_length_(a))
+        return a;
+    void *b = arr_resize_(a, array_length_(a), 0);
+    return b ? b : a;
+}
+
+
+
+#ifdef __GLIBC__
+s_allocator smalloc_allocator = {malloc, free, realloc, malloc_usable_size};
+#else
+s_allocator smalloc_allocator = {malloc, free, realloc};
+#endif
+
+void *smalloc_forward_alloc(void *ctx, size_t size) {
+    return ((const s_allocator *) ctx)->alloc(size);
+}
+
+void smalloc_forward_dealloc(void *ctx, void *ptr) {
+    ((const s_allocator *) ctx)->dealloc(ptr);
+}
+
+void *smalloc_forward_realloc(void *ctx, void *ptr, size_t size) {
+    return ((const s_allocator *) ctx)->realloc(ptr, size);
+}
+
+size_t smalloc_forward_usable_size(void *ctx, void *ptr) {
+    const s_allocator *allocator = ctx;
+    return allocator->usable_size ? allocator->usable_size(ptr) : 0;
+}
+
+const s_alloc_handle smalloc_default_handle = SMALLOC_HANDLE_OF(&smalloc_allocator);
+
+_Thread_local const s_alloc_handle *smalloc_thread_allocator_;
+
+const s_alloc_handle *smalloc_get_allocator(void) {
+    return smalloc_thread_allocator_ ? smalloc_thread_allocator_ : &smalloc_default_handle;
+}
+
+const s_alloc_handle *smalloc_set_allocator(const s_alloc_handle *allocator) {
+    const s_alloc_handle *prev = smalloc_get_allocator();
+    smalloc_thread_allocator_ = allocator;
+    return prev;
+}
+
+#ifdef __STDC_NO_ATOMICS__
+#ifdef _MSC_VER
+# include <windows.h>
+# include <malloc.h>
+#endif
+
+#ifndef _MSC_VER
+static CSPTR_INLINE int32_t atomic_add(volatile int32_t *count, const int32_t limit, const int32_t val) {
+    size_t old_count, new_count;
+    do {
+      old_count = *count;
+      if (old_count == limit)
+          abort();
+      new_count = old_count + val;
+    } while (!__sync_bool_compare_and_swap(count, old_count, new_count));
+    return new_count;
+}
+#endif
+
+static CSPTR_INLINE int32_t atomic_increment(volatile int32_t *count) {
+#ifdef _MSC_VER
+    return InterlockedIncrement64(count);
+#else
+    return atomic_add(count, INT32_MAX, 1);
+#endif
+}
+
+static CSPTR_INLINE int32_t atomic_decrement(volatile int32_t *count) {
+#ifdef _MSC_VER
+    return InterlockedDecrement64(count);
+#else
+    return atomic_add(count, 0, -1);
+#endif
+}
+
+#else
+
+static CSPTR_INLINE int32_t atomic_increment(volatile atomic_int *count) {
+    return atomic_fetch_add(count, 1) + 1;
+}
+
+static CSPTR_INLINE int32_t atomic_decrement(volatile atomic_int *count) {
+    return atomic_fetch_sub(count, 1) - 1;
+}
+
+#endif
+
+static CSPTR_INLINE int32_t atomic_add_n_(smt_refcount_ *count, int32_t val) {
+#ifndef __STDC_NO_ATOMICS__
+    return atomic_fetch_add(count, val) + val;
+#elif defined(_MSC_VER)
+    return InterlockedAdd(count, val);
+#else
+    return __sync_add_and_fetch(count, val);
+#endif
+}
+
+// SHARED_LOCAL counts: relaxed load + store, i.e. plain moves, no locked RMW
+static CSPTR_INLINE int32_t local_add_(smt_refcount_ *count, int32_t val) {
+#ifndef __STDC_NO_ATOMICS__
+    const int32_t n = atomic_load_explicit(count, memory_order_relaxed) + val;
+    atomic_store_explicit(count, n, memory_order_relaxed);
+    return n;
+#else
+    return *count += val;
+#endif
+}
+
+#ifndef __STDC_NO_ATOMICS__
+#include <pthread.h>
+#include <sched.h>
+#include <limits.h>
+
+/* shared count flags of SHARED_BIASED objects: MERGED once the owner gave
+ * up its biased count, QUEUED while waiting in the owner's queue */
+#define BRC_MERGED_ 1
+#define BRC_QUEUED_ 2
+#define BRC_ONE_ 4
+// queue head of an exited owner
+#define BRC_DEAD_ ((void *) 1)
+
+static _Thread_local s_brc_owner *brc_self_owner_;
+static pthread_once_t brc_once_ = PTHREAD_ONCE_INIT;
+static pthread_key_t brc_key_;
+static _Atomic(s_brc_owner *) brc_retired_;
+
+static void brc_thread_exit_(void *owner) {
+    sbiased_collect();
+    s_brc_owner *o = owner;
+    o->next = atomic_load(&brc_retired_);
+    while (!atomic_compare_exchange_weak(&brc_retired_, &o->next, o))
+        ;
+}
+
+static void brc_make_key_(void) {
+    pthread_key_create(&brc_key_, brc_thread_exit_);
+}
+
+static s_brc_owner *brc_self_(void) {
+    if (brc_self_owner_)
+        return brc_self_owner_;
+    s_brc_owner *owner = malloc(sizeof (s_brc_owner));
+    if (!owner)
+        return NULL;
+    atomic_init(&owner->queue, NULL);
+    owner->next = NULL;
+    pthread_once(&brc_once_, brc_make_key_);
+    pthread_setspecific(brc_key_, owner);
+    return brc_self_owner_ = owner;
+}
+
+// only the owner sets BRC_MERGED_, so its own relaxed read is exact
+static CSPTR_INLINE int brc_owned_(s_meta_header *meta, const s_meta_biased *b) {
+    return b->owner == brc_self_owner_
+        && !(atomic_load_explicit(meta_refcount_(meta), memory_order_relaxed) & BRC_MERGED_);
+}
+
+static CSPTR_INLINE void brc_acquire_(s_meta_header *meta, int32_t n) {
+    s_meta_biased *b = meta_biased_(meta);
+    if (brc_owned_(meta, b))
+        b->biased += n;
+    else
+        atomic_fetch_add_explicit(meta_refcount_(meta), n * BRC_ONE_, memory_order_relaxed);
+}
+#endif /* !__STDC_NO_ATOMICS__ */
+
+void *sref(void *ptr) {
+    s_meta_header *meta = get_smart_ptr_meta_(ptr);
+    smt_check_meta_(meta, ptr);
+    assert(meta->kind & SHARED);
+    if (meta->kind & LOCAL) {
+        smt_check_owner_(meta);
+        local_add_(meta_refcount_(meta), 1);
+#ifndef __STDC_NO_ATOMICS__
+    } else if (meta->kind & BIASED) {
+        brc_acquire_(meta, 1);
+#endif
+    } else {
+        atomic_increment(meta_refcount_(meta));
+    }
+    stats_ref_(1);
+    trace_(CSPTR_TRACE_REF, trace_head_(meta), 1, 0, meta->kind);
+    return ptr;
+}
+
+void *sref_n(void *ptr, size_t n) {
+    s_meta_header *meta = get_smart_ptr_meta_(ptr);
+    smt_check_meta_(meta, ptr);
+    assert(meta->kind & SHARED);
+    assert(n <= INT32_MAX / 4);
+    if (meta->kind & LOCAL) {
+        smt_check_owner_(meta);
+        local_add_(meta_refcount_(meta), (int32_t) n);
+#ifndef __STDC_NO_ATOMICS__
+    } else if (meta->kind & BIASED) {
+        brc_acquire_(meta, (int32_t) n);
+#endif
+    } else {
+        atomic_add_n_(meta_refcount_(meta), (int32_t) n);
+    }
+    stats_ref_(n);
+    trace_(CSPTR_TRACE_REF, trace_head_(meta), n, 0, meta->kind);
+    return ptr;
+}
+
+void *smove_size(void *ptr, size_t size) {
+    s_meta_header *meta = get_smart_ptr_meta_(ptr);
+    assert(meta->kind & UNIQUE);
+
+    s_smalloc_args args;
+
+    const size_t userdata_size = meta_userdata_size_(meta, ptr);
+    if (meta->kind & DYNAMIC_ARRAY) {
+        s_meta_array *arr_meta = get_smart_ptr_meta_array_(ptr);
+        args = (s_smalloc_args) {
+            .item_size = arr_meta->item_size,
+            .item_cap = arr_meta->item_num,
+            .kind = (enum pointer_kind) (SHARED | DYNAMIC_ARRAY),
+            .dtor = meta->kind & ARRAY_DTOR ? NULL : meta_dtor_(meta),
+            .array_dtor = meta->kind & ARRAY_DTOR
+                ? (f_array_destructor) (void (*)(void)) meta_dtor_(meta) : NULL,
+            .userdata = { arr_meta, userdata_size },    // TODO: Fix it
+            .allocator = meta_allocator_(meta),
+        };
+    } else {
+        void *userdata = get_smart_ptr_userdata(ptr);
+        args = (s_smalloc_args) {
+            .item_size = size,
+            .kind = SHARED,
+            .dtor = meta_dtor_(meta),
+            .userdata = {userdata, userdata_size },
+            .allocator = meta_allocator_(meta),
+        };
+    }
+
+    void *newptr = smalloc_impl_(&args);
+    memcpy(newptr, ptr, size);
+    return newptr;
+}
+
+CSPTR_MALLOC_API
+CSPTR_INLINE static void *alloc_entry(const s_alloc_handle *allocator, size_t totalsize) {
+#ifdef SMALLOC_FIXED_ALLOCATOR
+    (void) allocator;
+    char *raw = malloc(totalsize + SMT_PREFIX_);
+#else /* !SMALLOC_FIXED_ALLOCATOR */
+    char *raw = allocator->alloc(allocator->ctx, totalsize + SMT_PREFIX_);
+#endif /* !SMALLOC_FIXED_ALLOCATOR */
+    return raw ? raw + SMT_PREFIX_ : NULL;
+}
+
+// `count` items from `base`, with either form of destructor
+static void destroy_items_(const s_meta_header *meta, f_destructor dtor, char *base,
+                           size_t count, size_t item_size, void *userdata) {
+    if (meta->kind & ARRAY_DTOR) {
+        ((f_array_destructor) (void (*)(void)) dtor)(base, count, item_size, userdata);
+        return;
+    }
+    for (size_t i = 0; i < count; ++i)
+        dtor(base + item_size * i, userdata);
+}
+
+CSPTR_INLINE static void destroy_entry(s_meta_header *meta, void *ptr) {
+    const f_destructor dtor = meta_dtor_(meta);
+    if (dtor) {
+        void * const userdata = get_smart_ptr_userdata(ptr);
+        if (meta->kind & DYNAMIC_ARRAY) {
+            s_meta_array *arr_meta = meta_array_(meta);
+            if (arr_meta->item_num)
+                destroy_items_(meta, dtor, ptr, arr_meta->item_num, arr_meta->item_size, userdata);
+        }
+        else
+            dtor(ptr, userdata);
+    }
+}
+
+void smt__arrdestroyf_(void *a, size_t i, size_t n) {
+    s_meta_header *meta = get_smart_ptr_meta_(a);
+    const size_t item_size = meta_array_(meta)->item_size;
+    destroy_items_(meta, meta_dtor_(meta), (char *) a + item_size * i, n, item_size, get_smart_ptr_userdata(a));
+}
+
+CSPTR_INLINE static void free_entry_(s_meta_header *meta, void *ptr) {
+    stats_free_(meta, ptr);
+    heap_free_(meta);
+    trace_(CSPTR_TRACE_RELEASE, trace_head_(meta), 0, 0, meta->kind);
+#ifdef SMALLOC_FIXED_ALLOCATOR
+    free((char *) meta_raw_(meta) - SMT_PREFIX_);
+#else /* !SMALLOC_FIXED_ALLOCATOR */
+    const s_alloc_handle *allocator = meta_allocator_(meta);
+    allocator->dealloc(allocator->ctx, (char *) meta_raw_(meta) - SMT_PREFIX_);
+#endif /* !SMALLOC_FIXED_ALLOCATOR */
+}
+
+CSPTR_INLINE static void dealloc_entry(s_meta_header *meta, void *ptr) {
+    destroy_entry(meta, ptr);
+
+    // outstanding weak references keep the block
+    if (meta->kind & SHARED && atomic_decrement(meta_weak_count_(meta)))
+        return;
+    free_entry_(meta, ptr);
+}
+
+static void epoch_retire_(s_meta_header *meta, void *ptr);
+static int reclaim_push_(s_meta_header *meta, void *ptr);
+static _Thread_local int reclaim_defer_;
+
+// whether this release may go to the reclaimer thread
+static CSPTR_INLINE int reclaim_wants_(const s_meta_header *meta) {
+    return reclaim_defer_ && !(meta->kind & LOCAL)
+        && (reclaim_defer_ == CSPTR_RECLAIM_ALL || !meta_dtor_(meta));
+}
+
+// the last reference is gone
+static void release_entry_(s_meta_header *meta, void *ptr) {
+    // arena blocks are destroyed and released together by sarena_reset
+    if (meta->kind & ARENA)
+        return;
+    if (meta->kind & EPOCH)
+        epoch_retire_(meta, ptr);
+    else if (!(reclaim_wants_(meta) && reclaim_push_(meta, ptr)))
+        dealloc_entry(meta, ptr);
+}
+
+CSPTR_MALLOC_API
+void *smalloc_impl_(const s_smalloc_args *args) {
+    if (!(args->item_size && args->item_cap))
+        return NULL;
+
+    const size_t alignment = args->alignment > sizeof (char *) ? args->alignment : sizeof (char *);
+    if (alignment & (alignment - 1) || alignment > SMALLOC_MAX_ALIGNMENT)
+        return NULL;
+
+    // align the sizes to the item_size of a word
+    size_t aligned_userdata_size = align(args->userdata.size);
+    size_t rawdata_size = align(args->item_size * args->item_cap);
+    // allocators only guarantee word alignment, the rest is padding
+    const size_t align_slack = alignment - sizeof (char *);
+
+    const s_alloc_handle *allocator = args->allocator ? args->allocator : smalloc_get_allocator();
+    enum pointer_kind kind = args->arena ? args->kind | ARENA : args->kind;
+    // both forms share the dtor slot, ARRAY_DTOR tells them apart
+    f_destructor dtor = args->dtor;
+    kind &= ~ARRAY_DTOR;
+    if (args->array_dtor && kind & DYNAMIC_ARRAY) {
+        dtor = (f_destructor) (void (*)(void)) args->array_dtor;
+        kind |= ARRAY_DTOR;
+    }
+    s_brc_owner *owner = NULL;
+    if (kind & BIASED) {
+#ifndef __STDC_NO_ATOMICS__
+        if (!(owner = brc_self_()))
+            return NULL;
+#else
+        kind &= ~BIASED;
+#endif
+    }
+
+#ifdef CSPTR_ADJACENT_HEADER_
+#ifdef CSPTR_COMPACT_HEADER
+    const int has_allocator = !args->arena && allocator != &smalloc_default_handle;
+    size_t head_size = sizeof (s_meta_header)
+                     + (dtor ? sizeof (f_destructor) : 0)
+                     + (has_allocator ? sizeof (s_alloc_handle *) : 0)
+                     + (kind & SHARED ? sizeof (void *) : 0);
+#else
+    size_t head_size = sizeof (s_meta_header);
+#endif
+    head_size += kind & BIASED ? sizeof (s_meta_biased) : 0;
+    const size_t meta_size = aligned_userdata_size + get_meta_array_size_(kind) + head_size;
+    if (meta_size + align_slack > SMT_MAX_OFFSET_)
+        return NULL;
+#else
+    const size_t meta_size = get_meta_size_(kind) + aligned_userdata_size + sizeof (size_t);
+#endif
+
+    char *raw_ptr = args->arena
+        ? arena_alloc_(args->arena, meta_size + rawdata_size + align_slack)
+        : alloc_entry(allocator, meta_size + rawdata_size + align_slack);
+    if (raw_ptr == NULL)
+        return NULL;
+    if (!args->arena) {
+        stats_alloc_(raw_ptr, kind, meta_size + rawdata_size + align_slack, args->item_size * args->item_cap);
+        heap_alloc_(raw_ptr, meta_size + rawdata_size + align_slack, args);
+        trace_(CSPTR_TRACE_ALLOC, raw_ptr - SMT_PREFIX_, 0, meta_size + rawdata_size + align_slack + SMT_PREFIX_, kind);
+    }
+
+    const size_t align_pad = align_to_((size_t) raw_ptr + meta_size, alignment) - ((size_t) raw_ptr + meta_size);
+    void* smart_ptr = raw_ptr + meta_size + align_pad;
+
+#ifdef CSPTR_ADJACENT_HEADER_
+    s_meta_header *meta = get_smart_ptr_meta_(smart_ptr);
+    if (align_pad)
+        *(size_t *) raw_ptr = align_pad;
+#ifdef CSPTR_COMPACT_HEADER
+    *meta = (s_meta_header) {
+        .kind = kind,
+        .has_dtor = dtor != NULL,
+        .has_allocator = has_allocator,
+        .has_userdata = args->userdata.size != 0,
+        .has_pad = align_pad != 0,
+        .align_log2 = __builtin_ctzl(alignment),
+        .offset = meta_size + align_pad,
+    };
+    void **ext = (void **) meta;
+    if (dtor)
+        *(f_destructor *) --ext = dtor;
+    if (has_allocator)
+        *(const s_alloc_handle **) --ext = allocator;
+#else
+    *meta = (s_meta_header) {
+        .dtor = dtor,
+        .allocator = args->arena ? NULL : allocator,
+#ifndef NDEBUG
+        .ptr = smart_ptr,
+#endif
+        .kind = kind,
+        .has_userdata = args->userdata.size != 0,
+        .has_pad = align_pad != 0,
+        .align_log2 = __builtin_ctzl(alignment),
+        .offset = meta_size + align_pad,
+    };
+#endif
+#else
+    s_meta_header *meta = (s_meta_header *) raw_ptr;
+    ((size_t *) smart_ptr)[-1] = (char *) smart_ptr - sizeof (size_t) - raw_ptr;
+    *meta = (s_meta_header) {
+        .kind = kind,
+        .align_log2 = (uint8_t) __builtin_ctzl(alignment),
+        .align_pad = (uint16_t) align_pad,
+        .dtor = dtor,
+        .allocator = args->arena ? NULL : allocator,
+#ifndef NDEBUG
+        .ptr = smart_ptr
+#endif
+    };
+#endif
+
+    if (args->userdata.size && args->userdata.data)
+        memcpy(meta_userdata_(meta), args->userdata.data, args->userdata.size);
+
+    if (kind & DYNAMIC_ARRAY) {
+        *meta_array_(meta) = (s_meta_array) {
+                .item_capacity = args->item_cap,
+                .item_num = args->item_num,
+                .item_size = args->item_size
+        };
+    }
+
+    if (kind & SHARED) {
 #ifndef __STDC_NO_ATOMICS__
-        atomic_init(&((s_meta_shared *) raw_ptr)->ref_count, 1);
+        atomic_init(meta_weak_count_(meta), 1);
+        if (kind & BIASED) {
+            *meta_biased_(meta) = (s_meta_biased) { .owner = owner, .biased = 1 };
+            atomic_init(meta_refcount_(meta), 0);
+        } else {
+            atomic_init(meta_refcount_(meta), 1);
+        }
 #else
-        ((s_meta_shared*) raw_ptr)->ref_count = 1;
+        *meta_weak_count_(meta) = 1;
+        *meta_refcount_(meta) = 1;
 #endif
+        if (kind & LOCAL)
+            smt_set_owner_(meta);
+    }
+
+    if (args->arena && dtor) {
+        s_arena_dtor *rec = arena_bump_(args->arena, sizeof (s_arena_dtor));
+        if (rec == NULL)
+            return NULL;
+        *rec = (s_arena_dtor) { .ptr = smart_ptr };
+        arena_block_of_(raw_ptr)->dtor = rec;
+        *args->arena->dtors_tail = rec;
+        args->arena->dtors_tail = &rec->next;
     }
-    void* smart_ptr = sz_ptr + 1;
 
     if (args->value != NULL) {
         memcpy(smart_ptr, args->value, args->item_size * args->item_num);
@@ -478,42 +2211,734 @@ void *smalloc_impl_(const s_smalloc_args *args) {
 s_meta_array *get_smart_ptr_meta_array_(const void * const smart_ptr) {
     assert((size_t) smart_ptr == align((size_t) smart_ptr));
 
-    s_meta_header * const raw_ptr = get_smart_ptr_meta_(smart_ptr);
-    assert(raw_ptr->ptr == smart_ptr);
-    if (!(raw_ptr->kind & DYNAMIC_ARRAY) ){
-        return NULL;
-    }
-    size_t header_size = get_meta_header_size_(raw_ptr->kind);
-    s_meta_array* ma = (s_meta_array *)(((char*)raw_ptr) + header_size);
-    return ma;
+    s_meta_header * const meta = get_smart_ptr_meta_(smart_ptr);
+    smt_check_meta_(meta, smart_ptr);
+    return meta_array_(meta);
 }
 
 CSPTR_PURE
 void *get_smart_ptr_userdata(const void * const smart_ptr) {
     assert((size_t) smart_ptr == align((size_t) smart_ptr));
 
-    s_meta_header * const raw_ptr = get_smart_ptr_meta_(smart_ptr);
-    assert(raw_ptr->ptr == smart_ptr);
+    s_meta_header * const meta = get_smart_ptr_meta_(smart_ptr);
+    smt_check_meta_(meta, smart_ptr);
 
-    size_t header_size = get_meta_size_(raw_ptr->kind);
-    size_t *total_meta_size = (size_t *) smart_ptr - 1;
-    if (*total_meta_size == header_size)
+    if (!meta_userdata_size_(meta, smart_ptr))
         return NULL;
 
-    return (char *) raw_ptr + header_size;
+    return meta_userdata_(meta);
+}
+
+#ifndef __STDC_NO_ATOMICS__
+/* Epochs: a thread inside a critical section publishes the global epoch it
+ * saw. Retired objects wait in the limbo list of the epoch they were retired
+ * in; the global epoch only advances once every active thread has seen it,
+ * so after two advances nobody can still hold a retired object. The ring has
+ * four lists so the slot of an epoch stays put when the counter wraps. */
+typedef struct s_epoch_rec_s {
+    // epoch << 1 | inside a critical section
+    atomic_uint state;
+    atomic_int in_use;
+    struct s_epoch_rec_s *next;
+} s_epoch_rec;
+
+typedef struct s_epoch_node_s {
+    struct s_epoch_node_s *next;
+    void *ptr;
+} s_epoch_node;
+
+static struct {
+    atomic_uint epoch;
+    _Atomic(s_epoch_rec *) recs;
+    pthread_mutex_t lock;
+    s_epoch_node *limbo[4];
+    size_t pending;
+    pthread_once_t once;
+    pthread_key_t key;
+} epoch_ = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .once = PTHREAD_ONCE_INIT,
+};
+
+static _Thread_local s_epoch_rec *epoch_self_;
+static _Thread_local unsigned epoch_nest_;
+
+#ifdef CSPTR_TEST_HOOKS
+static atomic_int epoch_fail_nodes_;
+
+void csptr_test_epoch_seed(unsigned epoch) {
+    atomic_store(&epoch_.epoch, epoch);
+}
+
+void csptr_test_epoch_fail_nodes(int n) {
+    atomic_store(&epoch_fail_nodes_, n);
+}
+
+static s_epoch_node *epoch_node_new_(void) {
+    if (atomic_load(&epoch_fail_nodes_) > 0 && atomic_fetch_sub(&epoch_fail_nodes_, 1) > 0)
+        return NULL;
+    return malloc(sizeof (s_epoch_node));
+}
+#else
+# define epoch_node_new_() ((s_epoch_node *) malloc(sizeof (s_epoch_node)))
+#endif
+
+static void epoch_thread_exit_(void *rec) {
+    atomic_store(&((s_epoch_rec *) rec)->in_use, 0);
+}
+
+static void epoch_make_key_(void) {
+    pthread_key_create(&epoch_.key, epoch_thread_exit_);
+}
+
+static s_epoch_rec *epoch_rec_(void) {
+    s_epoch_rec *rec;
+    for (rec = atomic_load(&epoch_.recs); rec; rec = rec->next) {
+        int idle = 0;
+        if (atomic_compare_exchange_strong(&rec->in_use, &idle, 1))
+            break;
+    }
+    if (!rec) {
+        // without a record the thread cannot be tracked
+        if (!(rec = malloc(sizeof (s_epoch_rec))))
+            abort();
+        atomic_init(&rec->state, 0);
+        atomic_init(&rec->in_use, 1);
+        rec->next = atomic_load(&epoch_.recs);
+        while (!atomic_compare_exchange_weak(&epoch_.recs, &rec->next, rec))
+            ;
+    }
+    pthread_once(&epoch_.once, epoch_make_key_);
+    pthread_setspecific(epoch_.key, rec);
+    return epoch_self_ = rec;
+}
+
+void sepoch_enter(void) {
+    if (epoch_nest_++)
+        return;
+    s_epoch_rec *rec = epoch_self_ ? epoch_self_ : epoch_rec_();
+    atomic_store(&rec->state, atomic_load(&epoch_.epoch) << 1 | 1);
+}
+
+void sepoch_leave(void) {
+    assert(epoch_nest_);
+    if (--epoch_nest_)
+        return;
+    atomic_store_explicit(&epoch_self_->state, 0, memory_order_release);
+}
+
+/* with epoch_.lock held: advance when every active thread is in the
+ * current epoch, and return the objects that became safe */
+static s_epoch_node *epoch_try_advance_(void) {
+    const unsigned epoch = atomic_load(&epoch_.epoch);
+    for (s_epoch_rec *rec = atomic_load(&epoch_.recs); rec; rec = rec->next) {
+        const unsigned state = atomic_load(&rec->state);
+        if (state & 1 && state >> 1 != (epoch & (UINT_MAX >> 1)))
+            return NULL;
+    }
+    atomic_store(&epoch_.epoch, epoch + 1);
+    // retired two epochs ago
+    s_epoch_node *safe = epoch_.limbo[(epoch - 2) & 3];
+    epoch_.limbo[(epoch - 2) & 3] = NULL;
+    return safe;
+}
+
+static void epoch_reclaim_(s_epoch_node *node) {
+    while (node) {
+        s_epoch_node *next = node->next;
+        dealloc_entry(get_smart_ptr_meta_(node->ptr), node->ptr);
+        free(node);
+        node = next;
+    }
+}
+
+/* wait for two advances from now, whether or not anything is pending:
+ * then every thread that was inside a critical section has left it */
+static void epoch_synchronize_(void) {
+    const unsigned start = atomic_load(&epoch_.epoch);
+    for (;;) {
+        pthread_mutex_lock(&epoch_.lock);
+        s_epoch_node *safe = atomic_load(&epoch_.epoch) - start < 2 ? epoch_try_advance_() : NULL;
+        for (s_epoch_node *n = safe; n; n = n->next)
+            --epoch_.pending;
+        const unsigned advanced = atomic_load(&epoch_.epoch) - start;
+        pthread_mutex_unlock(&epoch_.lock);
+
+        epoch_reclaim_(safe);
+        if (advanced >= 2)
+            return;
+        sched_yield();
+    }
+}
+
+static void epoch_retire_(s_meta_header *meta, void *ptr) {
+    s_epoch_node *node = epoch_node_new_();
+    if (!node) {
+        // no room to defer: wait for the readers instead. Our own critical
+        // section would pin the epoch for good.
+        if (epoch_nest_)
+            abort();
+        epoch_synchronize_();
+        dealloc_entry(meta, ptr);
+        return;
+    }
+    node->ptr = ptr;
+
+    pthread_mutex_lock(&epoch_.lock);
+    const unsigned epoch = atomic_load(&epoch_.epoch);
+    node->next = epoch_.limbo[epoch & 3];
+    epoch_.limbo[epoch & 3] = node;
+    s_epoch_node *safe = NULL;
+    if (++epoch_.pending >= SEPOCH_BATCH) {
+        safe = epoch_try_advance_();
+        for (s_epoch_node *n = safe; n; n = n->next)
+            --epoch_.pending;
+    }
+    pthread_mutex_unlock(&epoch_.lock);
+
+    // destructors may sfree more SHARED_EPOCH objects: run them unlocked
+    epoch_reclaim_(safe);
+}
+
+void sepoch_flush(void) {
+    assert(!epoch_nest_);
+    for (;;) {
+        pthread_mutex_lock(&epoch_.lock);
+        s_epoch_node *safe = epoch_.pending ? epoch_try_advance_() : NULL;
+        for (s_epoch_node *n = safe; n; n = n->next)
+            --epoch_.pending;
+        const size_t pending = epoch_.pending;
+        pthread_mutex_unlock(&epoch_.lock);
+
+        epoch_reclaim_(safe);
+        if (!pending)
+            return;
+        if (!safe)
+            sched_yield();
+    }
+}
+
+/* fold the biased count into the shared one; frees the object when nothing
+ * is left. Runs on the owner, or on anyone once the owner has exited. */
+static void brc_merge_(void *ptr) {
+    s_meta_header *meta = get_smart_ptr_meta_(ptr);
+    s_meta_biased *b = meta_biased_(meta);
+    const int32_t bias = b->biased * BRC_ONE_;
+    b->biased = 0;
+
+    int32_t old = atomic_load(meta_refcount_(meta)), new;
+    do {
+        new = ((old + bias) | BRC_MERGED_) & ~BRC_QUEUED_;
+    } while (!atomic_compare_exchange_weak(meta_refcount_(meta), &old, new));
+
+    if ((new & ~BRC_MERGED_) == 0)
+        release_entry_(meta, ptr);
+}
+
+static void brc_push_(s_brc_owner *owner, void *ptr) {
+    s_meta_biased *b = meta_biased_(get_smart_ptr_meta_(ptr));
+    void *head = atomic_load(&owner->queue);
+    do {
+        if (head == BRC_DEAD_) {
+            brc_merge_(ptr);
+            return;
+        }
+        b->next = head;
+    } while (!atomic_compare_exchange_weak(&owner->queue, &head, ptr));
+}
+
+void sbiased_collect(void) {
+    s_brc_owner *owner = brc_self_owner_;
+    if (!owner)
+        return;
+    // once the thread is gone, pushers merge by themselves
+    void *p = atomic_exchange(&owner->queue, pthread_getspecific(brc_key_) ? NULL : BRC_DEAD_);
+    while (p && p != BRC_DEAD_) {
+        void *next = meta_biased_(get_smart_ptr_meta_(p))->next;
+        brc_merge_(p);
+        p = next;
+    }
+}
+
+// returns whether the last reference is gone
+static int brc_release_(s_meta_header *meta, void *ptr) {
+    s_meta_biased *b = meta_biased_(meta);
+    smt_refcount_ *rc = meta_refcount_(meta);
+
+    // may merge this very object, so check ownership afterwards
+    if (b->owner == brc_self_owner_ && atomic_load_explicit(&b->owner->queue, memory_order_relaxed))
+        sbiased_collect();
+
+    if (brc_owned_(meta, b)) {
+        if (--b->biased)
+            return 0;
+        // a queued object is finished by sbiased_collect instead
+        const int32_t old = atomic_fetch_or(rc, BRC_MERGED_);
+        return !(old & BRC_QUEUED_) && (old & ~BRC_MERGED_) == 0;
+    }
+
+    int32_t old = atomic_load(rc), new;
+    do {
+        new = old - BRC_ONE_;
+        // the owner holds the rest: hand the object over for merging
+        if (new < 0 && !(old & (BRC_MERGED_ | BRC_QUEUED_)))
+            new |= BRC_QUEUED_;
+    } while (!atomic_compare_exchange_weak(rc, &old, new));
+
+    if (new & BRC_QUEUED_ & ~old) {
+        brc_push_(b->owner, ptr);
+        return 0;
+    }
+    return (new & ~BRC_MERGED_) == 0 && new & BRC_MERGED_;
+}
+
+/* bounded multi-producer queue (one sequence number per cell), drained by
+ * the reclaimer thread */
+typedef struct {
+    atomic_size_t seq;
+    s_meta_header *meta;
+    void *ptr;
+} s_reclaim_cell;
+
+static struct {
+    s_reclaim_cell cells[CSPTR_RECLAIM_QUEUE];
+    // claimed by producers / released by the reclaimer, both only grow
+    atomic_size_t head;
+    atomic_size_t done;
+    atomic_int sleeping;
+    // set once by reclaim_start_, read by csptr_reclaim_flush without the once
+    atomic_int started;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    pthread_once_t once;
+} reclaim_ = {
+    .lock = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .once = PTHREAD_ONCE_INIT,
+};
+
+static void reclaim_wake_(void) {
+    pthread_mutex_lock(&reclaim_.lock);
+    pthread_cond_signal(&reclaim_.wake);
+    pthread_mutex_unlock(&reclaim_.lock);
+}
+
+static void *reclaim_main_(void *arg) {
+    (void) arg;
+    for (size_t tail = 0;;) {
+        s_reclaim_cell *cell = &reclaim_.cells[tail % CSPTR_RECLAIM_QUEUE];
+        if (atomic_load(&cell->seq) == tail + 1) {
+            s_meta_header *meta = cell->meta;
+            void *ptr = cell->ptr;
+            atomic_store_explicit(&cell->seq, tail + CSPTR_RECLAIM_QUEUE, memory_order_release);
+            ++tail;
+            dealloc_entry(meta, ptr);
+            atomic_fetch_add_explicit(&reclaim_.done, 1, memory_order_release);
+            continue;
+        }
+
+        // idle: announce it, then look once more before sleeping
+        pthread_mutex_lock(&reclaim_.lock);
+        atomic_store(&reclaim_.sleeping, 1);
+        if (atomic_load(&cell->seq) != tail + 1)
+            pthread_cond_wait(&reclaim_.wake, &reclaim_.lock);
+        atomic_store(&reclaim_.sleeping, 0);
+        pthread_mutex_unlock(&reclaim_.lock);
+    }
+    return NULL;
+}
+
+static void reclaim_start_(void) {
+    for (size_t i = 0; i < CSPTR_RECLAIM_QUEUE; ++i)
+        atomic_init(&reclaim_.cells[i].seq, i);
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, reclaim_main_, NULL) == 0) {
+        pthread_detach(thread);
+        atomic_store(&reclaim_.started, 1);
+    }
+}
+
+static int reclaim_push_(s_meta_header *meta, void *ptr) {
+    pthread_once(&reclaim_.once, reclaim_start_);
+    if (!atomic_load_explicit(&reclaim_.started, memory_order_relaxed))
+        return 0;
+
+    s_reclaim_cell *cell;
+    size_t pos = atomic_load_explicit(&reclaim_.head, memory_order_relaxed);
+    for (;;) {
+        cell = &reclaim_.cells[pos % CSPTR_RECLAIM_QUEUE];
+        const size_t seq = atomic_load_explicit(&cell->seq, memory_order_acquire);
+        if (seq == pos) {
+            if (atomic_compare_exchange_weak_explicit(&reclaim_.head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if ((ptrdiff_t) (seq - pos) < 0) {
+            // full: the reclaimer is a whole queue behind
+            return 0;
+        } else {
+            pos = atomic_load_explicit(&reclaim_.head, memory_order_relaxed);
+        }
+    }
+    cell->meta = meta;
+    cell->ptr = ptr;
+    atomic_store(&cell->seq, pos + 1);
+    if (atomic_load(&reclaim_.sleeping))
+        reclaim_wake_();
+    return 1;
+}
+
+int csptr_reclaim_defer(int mode) {
+    const int prev = reclaim_defer_;
+    reclaim_defer_ = mode;
+    return prev;
+}
+
+void csptr_reclaim_flush(void) {
+    if (!atomic_load(&reclaim_.started))
+        return;
+    const size_t target = atomic_load(&reclaim_.head);
+    while (atomic_load_explicit(&reclaim_.done, memory_order_acquire) < target) {
+        reclaim_wake_();
+        sched_yield();
+    }
+}
+#else
+void sbiased_collect(void) {
+}
+
+void sepoch_enter(void) {
+}
+
+void sepoch_leave(void) {
+}
+
+void sepoch_flush(void) {
+}
+
+#ifdef CSPTR_TEST_HOOKS
+void csptr_test_epoch_seed(unsigned epoch) {
+    (void) epoch;
+}
+
+void csptr_test_epoch_fail_nodes(int n) {
+    (void) n;
+}
+#endif
+
+static void epoch_retire_(s_meta_header *meta, void *ptr) {
+    dealloc_entry(meta, ptr);
+}
+
+static int reclaim_push_(s_meta_header *meta, void *ptr) {
+    (void) meta;
+    (void) ptr;
+    return 0;
+}
+
+int csptr_reclaim_defer(int mode) {
+    const int prev = reclaim_defer_;
+    reclaim_defer_ = mode;
+    return prev;
 }
 
-void sfree(void *smart_ptr) {
+void csptr_reclaim_flush(void) {
+}
+#endif /* !__STDC_NO_ATOMICS__ */
+
+void sfree_impl_(void *smart_ptr) {
     if (!smart_ptr) return;
+    stats_frees_(1);
 
     assert((size_t) smart_ptr == align((size_t) smart_ptr));
     s_meta_header *meta = get_smart_ptr_meta_(smart_ptr);
-    assert(meta->ptr == smart_ptr);
+    smt_check_meta_(meta, smart_ptr);
+    trace_(CSPTR_TRACE_FREE, trace_head_(meta), 1, 0, meta->kind);
+
+    if (meta->kind & LOCAL) {
+        smt_check_owner_(meta);
+        if (local_add_(meta_refcount_(meta), -1))
+            return;
+#ifndef __STDC_NO_ATOMICS__
+    } else if (meta->kind & BIASED) {
+        if (!brc_release_(meta, smart_ptr))
+            return;
+#endif
+    } else if (meta->kind & SHARED && atomic_decrement(meta_refcount_(meta))) {
+        return;
+    }
+
+    release_entry_(meta, smart_ptr);
+}
+
+#ifndef SFREE_MANY_BATCH
+# define SFREE_MANY_BATCH 64
+#endif
+
+static void sfree_dead_(void **dead, size_t n) {
+    if (reclaim_defer_) {
+        size_t left = 0;
+        for (size_t i = 0; i < n; ++i) {
+            s_meta_header *meta = get_smart_ptr_meta_(dead[i]);
+            if (!(reclaim_wants_(meta) && reclaim_push_(meta, dead[i])))
+                dead[left++] = dead[i];
+        }
+        n = left;
+    }
+    for (size_t i = 0; i < n; ++i)
+        destroy_entry(get_smart_ptr_meta_(dead[i]), dead[i]);
+    for (size_t i = 0; i < n; ++i) {
+        s_meta_header *meta = get_smart_ptr_meta_(dead[i]);
+        if (meta->kind & SHARED && atomic_decrement(meta_weak_count_(meta)))
+            continue;
+        free_entry_(meta, dead[i]);
+    }
+}
 
-    if (meta->kind & SHARED && atomic_decrement(&((s_meta_shared *) meta)->ref_count))
+void sfree_many(void *const *ptrs, size_t count) {
+    void *dead[SFREE_MANY_BATCH];
+    size_t ndead = 0;
+
+    for (size_t i = 0; i < count; ) {
+        void *ptr = ptrs[i];
+        size_t run = 1;
+        while (i + run < count && ptrs[i + run] == ptr)
+            ++run;
+        i += run;
+        if (!ptr)
+            continue;
+
+        s_meta_header *meta = get_smart_ptr_meta_(ptr);
+        smt_check_meta_(meta, ptr);
+        if (meta->kind & (LOCAL | BIASED)) {
+            while (run--)
+                sfree(ptr);
+            continue;
+        }
+        stats_frees_(run);
+        trace_(CSPTR_TRACE_FREE, trace_head_(meta), run, 0, meta->kind);
+        if (meta->kind & SHARED) {
+            if (atomic_add_n_(meta_refcount_(meta), -(int32_t) run))
+                continue;
+        } else {
+            assert(run == 1);
+        }
+
+        if (meta->kind & (ARENA | EPOCH)) {
+            release_entry_(meta, ptr);
+            continue;
+        }
+        dead[ndead++] = ptr;
+        if (ndead == SFREE_MANY_BATCH) {
+            sfree_dead_(dead, ndead);
+            ndead = 0;
+        }
+    }
+    sfree_dead_(dead, ndead);
+}
+
+// the pools of one thread, stacked in a single buffer
+static _Thread_local struct {
+    void **items;
+    size_t len;
+    size_t cap;
+    // where the innermost pool starts
+    size_t base;
+} pool_;
+
+void *sautorelease(void *ptr) {
+    if (!ptr)
+        return NULL;
+    if (pool_.len == pool_.cap) {
+        const size_t cap = pool_.cap ? pool_.cap * 2 : SFREE_MANY_BATCH;
+        void **items = realloc(pool_.items, cap * sizeof *items);
+        if (!items) {
+            sfree(ptr);
+            return NULL;
+        }
+        pool_.items = items;
+        pool_.cap = cap;
+    }
+    pool_.items[pool_.len++] = ptr;
+    return ptr;
+}
+
+void csptr_pool_drain(void) {
+    // a batch at a time from the top: destructors may register more
+    void *batch[SFREE_MANY_BATCH];
+    while (pool_.len > pool_.base) {
+        size_t n = pool_.len - pool_.base;
+        if (n > SFREE_MANY_BATCH)
+            n = SFREE_MANY_BATCH;
+        pool_.len -= n;
+        memcpy(batch, pool_.items + pool_.len, n * sizeof *batch);
+        sfree_many(batch, n);
+    }
+}
+
+size_t csptr_pool_enter(void) {
+    const size_t outer = pool_.base;
+    pool_.base = pool_.len;
+    return outer;
+}
+
+void csptr_pool_leave(size_t *outer) {
+    csptr_pool_drain();
+    pool_.base = *outer;
+}
+
+s_weak *sweak(void *ptr) {
+    s_meta_header *meta = get_smart_ptr_meta_(ptr);
+    smt_check_meta_(meta, ptr);
+    assert(meta->kind & SHARED);
+    // arena blocks go away with sarena_reset regardless
+    assert(!(meta->kind & ARENA));
+    atomic_increment(meta_weak_count_(meta));
+    return (s_weak *) ptr;
+}
+
+void *slock(s_weak *weak) {
+    if (!weak)
+        return NULL;
+
+    void *ptr = weak;
+    s_meta_header *meta = get_smart_ptr_meta_(ptr);
+    smt_refcount_ *rc = meta_refcount_(meta);
+
+    if (meta->kind & LOCAL) {
+        smt_check_owner_(meta);
+        if (!local_add_(rc, 0))
+            return NULL;
+        local_add_(rc, 1);
+        return ptr;
+    }
+#ifndef __STDC_NO_ATOMICS__
+    if (meta->kind & BIASED) {
+        s_meta_biased *b = meta_biased_(meta);
+        // an owner still counting alone holds at least one reference
+        if (brc_owned_(meta, b)) {
+            ++b->biased;
+            return ptr;
+        }
+        int32_t old = atomic_load(rc);
+        do {
+            if (old & BRC_MERGED_ && (old & ~(BRC_MERGED_ | BRC_QUEUED_)) == 0)
+                return NULL;
+        } while (!atomic_compare_exchange_weak(rc, &old, old + BRC_ONE_));
+        return ptr;
+    }
+
+    int32_t old = atomic_load(rc);
+    do {
+        if (!old)
+            return NULL;
+    } while (!atomic_compare_exchange_weak(rc, &old, old + 1));
+#else
+    int32_t old;
+    do {
+        old = *rc;
+        if (!old)
+            return NULL;
+    } while (!__sync_bool_compare_and_swap(rc, old, old + 1));
+#endif
+    return ptr;
+}
+
+void sweak_free(s_weak *weak) {
+    if (!weak)
         return;
+    s_meta_header *meta = get_smart_ptr_meta_(weak);
+    if (!atomic_decrement(meta_weak_count_(meta)))
+        free_entry_(meta, weak);
+}
+
+#ifndef SARENA_DEFAULT_CHUNK
+# define SARENA_DEFAULT_CHUNK (64 * 1024)
+#endif
+
+static s_arena_chunk *arena_chunk_new_(const s_alloc_handle *allocator, size_t size) {
+    s_arena_chunk *chunk = allocator->alloc(allocator->ctx, sizeof (s_arena_chunk) + size);
+    if (chunk)
+        *chunk = (s_arena_chunk) { .size = size };
+    return chunk;
+}
+
+static void *arena_bump_(s_arena *arena, size_t size) {
+    size = align(size);
+    s_arena_chunk *chunk = arena->chunk;
+    if (chunk->size - chunk->used < size) {
+        chunk = arena_chunk_new_(arena->allocator, size > arena->chunk_size ? size : arena->chunk_size);
+        if (chunk == NULL)
+            return NULL;
+        chunk->next = arena->chunk;
+        arena->chunk = chunk;
+    }
+    void *p = (char *) (chunk + 1) + chunk->used;
+    chunk->used += size;
+    return p;
+}
+
+// returns the block right after its s_arena_block prefix
+static void *arena_alloc_(s_arena *arena, size_t size) {
+    s_arena_block *blk = arena_bump_(arena, sizeof (s_arena_block) + size);
+    if (blk == NULL)
+        return NULL;
+    *blk = (s_arena_block) { .arena = arena };
+    return blk + 1;
+}
+
+static void *arena_realloc_(void *raw_ptr, size_t old_size, size_t new_size) {
+    const s_arena_block *old = arena_block_of_(raw_ptr);
+    void *b = arena_alloc_(old->arena, new_size);
+    if (b) {
+        arena_block_of_(b)->dtor = old->dtor;
+        memcpy(b, raw_ptr, old_size);
+    }
+    return b;
+}
+
+s_arena *sarena_new(size_t chunk_size) {
+    if (!chunk_size)
+        chunk_size = SARENA_DEFAULT_CHUNK;
+    const s_alloc_handle *allocator = smalloc_get_allocator();
+    s_arena *arena = allocator->alloc(allocator->ctx, sizeof (s_arena));
+    if (arena == NULL)
+        return NULL;
+    *arena = (s_arena) {
+        .allocator = allocator,
+        .chunk = arena_chunk_new_(allocator, chunk_size),
+        .chunk_size = chunk_size,
+    };
+    if (arena->chunk == NULL) {
+        allocator->dealloc(allocator->ctx, arena);
+        return NULL;
+    }
+    arena->dtors_tail = &arena->dtors;
+    return arena;
+}
+
+void sarena_reset(s_arena *arena) {
+    for (s_arena_dtor *rec = arena->dtors; rec; rec = rec->next)
+        destroy_entry(get_smart_ptr_meta_(rec->ptr), rec->ptr);
+    arena->dtors = NULL;
+    arena->dtors_tail = &arena->dtors;
+
+    // keep the first chunk, which always has the default size, for the next round
+    s_arena_chunk *chunk = arena->chunk;
+    while (chunk->next) {
+        s_arena_chunk *next = chunk->next;
+        arena->allocator->dealloc(arena->allocator->ctx, chunk);
+        chunk = next;
+    }
+    chunk->used = 0;
+    arena->chunk = chunk;
+}
 
-    dealloc_entry(meta, smart_ptr);
+void sarena_free(s_arena *arena) {
+    if (!arena) return;
+    sarena_reset(arena);
+    const s_alloc_handle *allocator = arena->allocator;
+    allocator->dealloc(allocator->ctx, arena->chunk);
+    allocator->dealloc(allocator->ctx, arena);
 }
 
 #endif
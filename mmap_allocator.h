@@ -0,0 +1,155 @@
+/* mmap_allocator.h - anonymous-mapping backend for large csptr arrays
+ *
+ * An `s_alloc_handle` whose blocks stay on malloc until they reach
+ * `threshold` bytes, then move to their own anonymous mapping. Mapped
+ * blocks grow with mremap, which relinks the pages instead of copying them,
+ * so smt__arrgrowf_ stays cheap for arrays of hundreds of MB. With
+ * `huge_pages` set, mappings are advised for transparent huge pages.
+ *
+ *     int *a = unique_arr(int, 16, .allocator = &mmap_alloc_handle);
+ *
+ * mremap needs _GNU_SOURCE on Linux; without it growth falls back to
+ * map + copy + unmap.
+ */
+
+#ifndef CSPTR_H_MMAP_ALLOCATOR_H
+#define CSPTR_H_MMAP_ALLOCATOR_H
+
+#include "csptr.h"
+
+#ifndef MMAP_DEFAULT_THRESHOLD
+# define MMAP_DEFAULT_THRESHOLD (1024 * 1024)
+#endif
+
+typedef struct {
+    size_t threshold;
+    int huge_pages;
+} s_mmap_allocator;
+
+/* ctx is a const s_mmap_allocator * */
+CSPTR_MALLOC_API void *mmap_alloc(void *ctx, size_t size);
+void mmap_dealloc(void *ctx, void *ptr);
+void *mmap_realloc(void *ctx, void *ptr, size_t size);
+/* the rest of the last page for mapped blocks, 0 for blocks on malloc */
+size_t mmap_usable_size(void *ctx, void *ptr);
+
+# define MMAP_HANDLE_OF(Config) { mmap_alloc, mmap_dealloc, mmap_realloc, (void *) (Config), mmap_usable_size }
+
+/* MMAP_DEFAULT_THRESHOLD, no huge pages */
+extern const s_alloc_handle mmap_alloc_handle;
+
+#endif //CSPTR_H_MMAP_ALLOCATOR_H
+
+#if defined(MY_LIBCSPTR_IMPLEMENTATION) && !defined(CSPTR_MMAP_IMPLEMENTED_)
+#define CSPTR_MMAP_IMPLEMENTED_
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* in front of every block; `mapped` is 0 for blocks still on malloc */
+typedef struct {
+    size_t mapped;
+    size_t size;
+} s_mmap_prefix;
+
+static size_t mmap_round_(size_t size) {
+    static size_t page;
+    if (!page)
+        page = (size_t) sysconf(_SC_PAGESIZE);
+    return (size + page - 1) & ~(page - 1);
+}
+
+static s_mmap_prefix *mmap_map_(const s_mmap_allocator *cfg, size_t size) {
+    const size_t mapped = mmap_round_(sizeof (s_mmap_prefix) + size);
+    s_mmap_prefix *raw = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED)
+        return NULL;
+#ifdef MADV_HUGEPAGE
+    if (cfg->huge_pages)
+        madvise(raw, mapped, MADV_HUGEPAGE);
+#else
+    (void) cfg;
+#endif
+    *raw = (s_mmap_prefix) { .mapped = mapped, .size = size };
+    return raw;
+}
+
+CSPTR_MALLOC_API
+void *mmap_alloc(void *ctx, size_t size) {
+    const s_mmap_allocator *cfg = ctx;
+    s_mmap_prefix *raw;
+    if (size >= cfg->threshold) {
+        raw = mmap_map_(cfg, size);
+    } else {
+        raw = malloc(sizeof (s_mmap_prefix) + size);
+        if (raw)
+            *raw = (s_mmap_prefix) { .size = size };
+    }
+    return raw ? raw + 1 : NULL;
+}
+
+void mmap_dealloc(void *ctx, void *ptr) {
+    (void) ctx;
+    if (!ptr)
+        return;
+    s_mmap_prefix *raw = (s_mmap_prefix *) ptr - 1;
+    if (raw->mapped)
+        munmap(raw, raw->mapped);
+    else
+        free(raw);
+}
+
+void *mmap_realloc(void *ctx, void *ptr, size_t size) {
+    const s_mmap_allocator *cfg = ctx;
+    if (!ptr)
+        return mmap_alloc(ctx, size);
+
+    s_mmap_prefix *raw = (s_mmap_prefix *) ptr - 1;
+    if (!raw->mapped && size < cfg->threshold) {
+        raw = realloc(raw, sizeof (s_mmap_prefix) + size);
+        if (!raw)
+            return NULL;
+        raw->size = size;
+        return raw + 1;
+    }
+
+    if (raw->mapped) {
+        const size_t mapped = mmap_round_(sizeof (s_mmap_prefix) + size);
+        if (mapped == raw->mapped) {
+            raw->size = size;
+            return ptr;
+        }
+#ifdef MREMAP_MAYMOVE
+        s_mmap_prefix *b = mremap(raw, raw->mapped, mapped, MREMAP_MAYMOVE);
+        if (b == MAP_FAILED)
+            return NULL;
+#ifdef MADV_HUGEPAGE
+        if (cfg->huge_pages)
+            madvise(b, mapped, MADV_HUGEPAGE);
+#endif
+        b->mapped = mapped;
+        b->size = size;
+        return b + 1;
+#endif
+    }
+
+    // crossing the threshold (or no mremap): one last copy into a mapping
+    s_mmap_prefix *b = mmap_map_(cfg, size);
+    if (!b)
+        return NULL;
+    // callers may have used the whole mapping, not just raw->size
+    const size_t used = raw->mapped ? raw->mapped - sizeof (s_mmap_prefix) : raw->size;
+    memcpy(b + 1, ptr, used < size ? used : size);
+    mmap_dealloc(ctx, ptr);
+    return b + 1;
+}
+
+size_t mmap_usable_size(void *ctx, void *ptr) {
+    (void) ctx;
+    const s_mmap_prefix *raw = (const s_mmap_prefix *) ptr - 1;
+    return raw->mapped ? raw->mapped - sizeof (s_mmap_prefix) : 0;
+}
+
+static const s_mmap_allocator mmap_default_config_ = { .threshold = MMAP_DEFAULT_THRESHOLD };
+const s_alloc_handle mmap_alloc_handle = MMAP_HANDLE_OF(&mmap_default_config_);
+
+#endif
@@ -0,0 +1,315 @@
+/* slab_allocator.h - size-class slab pool for csptr.h
+ *
+ * A drop-in `s_allocator` tuned for the small blocks smalloc_impl_ produces
+ * (meta header + offset word + payload, e.g. ~40 bytes for unique_ptr(int)).
+ * Each thread keeps a free list per size class; empty lists are refilled in
+ * batches from a central, per-class locked list which carves fresh chunks.
+ * Blocks above SLAB_MAX_SIZE fall through to malloc.
+ *
+ * A block remembers the thread that allocated it. Freed on another thread
+ * (producer/consumer pipelines), it is pushed onto a lock-free remote list
+ * of its owner, which takes the whole list back in one exchange the next
+ * time its own list of that class runs dry. Blocks freed to an exited
+ * owner wait for the next thread that takes its place.
+ *
+ *     smalloc_allocator = slab_allocator;   // before the first smalloc
+ *     int *p = unique_ptr(int, 42, .allocator = &slab_alloc_handle);
+ */
+
+#ifndef CSPTR_H_SLAB_ALLOCATOR_H
+#define CSPTR_H_SLAB_ALLOCATOR_H
+
+#include "csptr.h"
+
+#ifndef SLAB_CHUNK_SIZE
+# define SLAB_CHUNK_SIZE (64 * 1024)
+#endif
+
+/* size classes: 8 bytes apart up to 256, then 64 bytes apart up to 1024 */
+#define SLAB_MAX_SIZE 1024
+#define SLAB_CLASSES  (1 + 256 / 8 + (SLAB_MAX_SIZE - 256) / 64)
+
+CSPTR_MALLOC_API void *slab_alloc(size_t size);
+void slab_dealloc(void *ptr);
+void *slab_realloc(void *ptr, size_t size);
+/* the size class of `ptr`, 0 for blocks above SLAB_MAX_SIZE */
+size_t slab_usable_size(void *ptr);
+/* hand every block cached by the calling thread, and every block other
+ * threads freed back to it, to the central lists */
+void slab_thread_flush(void);
+
+extern const s_allocator slab_allocator;
+extern const s_alloc_handle slab_alloc_handle;
+
+#endif //CSPTR_H_SLAB_ALLOCATOR_H
+
+#if defined(MY_LIBCSPTR_IMPLEMENTATION) && !defined(CSPTR_SLAB_IMPLEMENTED_)
+#define CSPTR_SLAB_IMPLEMENTED_
+#include <pthread.h>
+#include <stdatomic.h>
+
+/* every block is prefixed with its owner record, or'ed with its size class
+ * in the low bits; 0 marks a malloc'ed block */
+typedef union {
+    uintptr_t tag;
+    void *align_;
+} s_slab_prefix;
+
+#define SLAB_CLASS_MASK_ ((uintptr_t) 63)
+_Static_assert(SLAB_CLASSES <= SLAB_CLASS_MASK_ + 1, "size classes must fit the tag");
+
+typedef struct s_slab_free_s {
+    struct s_slab_free_s *next;
+} s_slab_free;
+
+/* the blocks other threads freed back to one thread; records outlive their
+ * thread and are handed to the next one */
+typedef struct s_slab_owner_s {
+    _Alignas(SLAB_CLASS_MASK_ + 1) _Atomic(s_slab_free *) remote[SLAB_CLASSES];
+    struct s_slab_owner_s *next;
+    atomic_int in_use;
+} s_slab_owner;
+
+typedef struct {
+    s_slab_free *head[SLAB_CLASSES];
+    uint32_t count[SLAB_CLASSES];
+    s_slab_owner *self;
+} s_slab_cache;
+
+static struct {
+    pthread_mutex_t lock[SLAB_CLASSES];
+    s_slab_free *head[SLAB_CLASSES];
+    _Atomic(s_slab_owner *) owners;
+    pthread_once_t once;
+    pthread_key_t key;
+} slab_central_ = {
+    .lock = { [0 ... SLAB_CLASSES - 1] = PTHREAD_MUTEX_INITIALIZER },
+    .once = PTHREAD_ONCE_INIT,
+};
+
+static _Thread_local s_slab_cache slab_cache_;
+
+static CSPTR_INLINE size_t slab_class_(const s_slab_prefix *raw) {
+    return raw->tag & SLAB_CLASS_MASK_;
+}
+
+static CSPTR_INLINE size_t slab_class_of_(size_t size) {
+    if (size <= 256)
+        return size ? (size + 7) / 8 : 1;
+    return 256 / 8 + (size - 256 + 63) / 64;
+}
+
+static CSPTR_INLINE size_t slab_class_size_(size_t cls) {
+    return cls <= 256 / 8 ? cls * 8 : 256 + (cls - 256 / 8) * 64;
+}
+
+static CSPTR_INLINE uint32_t slab_batch_(size_t cls) {
+    size_t n = 8192 / (sizeof (s_slab_prefix) + slab_class_size_(cls));
+    return n < 8 ? 8 : n > 128 ? 128 : (uint32_t) n;
+}
+
+static void slab_thread_exit_(void *cache) {
+    (void) cache;
+    slab_thread_flush();
+    // frees from here on go to the record like any other remote free
+    s_slab_owner *self = slab_cache_.self;
+    slab_cache_.self = NULL;
+    atomic_store(&self->in_use, 0);
+}
+
+static void slab_make_key_(void) {
+    pthread_key_create(&slab_central_.key, slab_thread_exit_);
+}
+
+// take over the record of an exited thread, or add one
+static int slab_adopt_(void) {
+    pthread_once(&slab_central_.once, slab_make_key_);
+    s_slab_owner *rec;
+    for (rec = atomic_load(&slab_central_.owners); rec; rec = rec->next) {
+        int idle = 0;
+        if (atomic_compare_exchange_strong(&rec->in_use, &idle, 1))
+            break;
+    }
+    if (!rec) {
+        rec = aligned_alloc(SLAB_CLASS_MASK_ + 1, sizeof (s_slab_owner));
+        if (!rec)
+            return 0;
+        for (size_t cls = 0; cls < SLAB_CLASSES; ++cls)
+            atomic_init(&rec->remote[cls], NULL);
+        atomic_init(&rec->in_use, 1);
+        rec->next = atomic_load(&slab_central_.owners);
+        while (!atomic_compare_exchange_weak(&slab_central_.owners, &rec->next, rec))
+            ;
+    }
+    slab_cache_.self = rec;
+    pthread_setspecific(slab_central_.key, &slab_cache_);
+    return 1;
+}
+
+/* move the blocks other threads freed back to us into the cache */
+static int slab_collect_(size_t cls) {
+    _Atomic(s_slab_free *) *remote = &slab_cache_.self->remote[cls];
+    if (!atomic_load_explicit(remote, memory_order_relaxed))
+        return 0;
+    s_slab_free *first = atomic_exchange_explicit(remote, NULL, memory_order_acquire);
+    s_slab_free *last = first;
+    uint32_t taken = 1;
+    for (; last->next; last = last->next)
+        ++taken;
+    last->next = slab_cache_.head[cls];
+    slab_cache_.head[cls] = first;
+    slab_cache_.count[cls] += taken;
+    return 1;
+}
+
+/* move up to `n` blocks of class `cls` from the central list into the cache,
+ * carving a new chunk when the central list runs dry */
+static int slab_refill_(size_t cls, uint32_t n) {
+    if (!slab_cache_.self && !slab_adopt_())
+        return 0;
+    if (slab_collect_(cls))
+        return 1;
+
+    pthread_mutex_lock(&slab_central_.lock[cls]);
+    if (!slab_central_.head[cls]) {
+        const size_t stride = sizeof (s_slab_prefix) + slab_class_size_(cls);
+        char *chunk = malloc(SLAB_CHUNK_SIZE);
+        if (!chunk) {
+            pthread_mutex_unlock(&slab_central_.lock[cls]);
+            return 0;
+        }
+        s_slab_free *head = NULL;
+        for (size_t off = SLAB_CHUNK_SIZE / stride * stride; off; ) {
+            off -= stride;
+            ((s_slab_prefix *) (chunk + off))->tag = cls;
+            s_slab_free *blk = (s_slab_free *) (chunk + off + sizeof (s_slab_prefix));
+            blk->next = head;
+            head = blk;
+        }
+        slab_central_.head[cls] = head;
+    }
+
+    s_slab_free *first = slab_central_.head[cls], *last = first;
+    uint32_t taken = 1;
+    while (taken < n && last->next) {
+        last = last->next;
+        ++taken;
+    }
+    slab_central_.head[cls] = last->next;
+    pthread_mutex_unlock(&slab_central_.lock[cls]);
+
+    last->next = slab_cache_.head[cls];
+    slab_cache_.head[cls] = first;
+    slab_cache_.count[cls] += taken;
+    return 1;
+}
+
+/* give `n` cached blocks of class `cls` back to the central list */
+static void slab_release_(size_t cls, uint32_t n) {
+    s_slab_free *first = slab_cache_.head[cls], *last = first;
+    if (!first || !n)
+        return;
+    uint32_t given = 1;
+    while (given < n && last->next) {
+        last = last->next;
+        ++given;
+    }
+    slab_cache_.head[cls] = last->next;
+    slab_cache_.count[cls] -= given;
+
+    pthread_mutex_lock(&slab_central_.lock[cls]);
+    last->next = slab_central_.head[cls];
+    slab_central_.head[cls] = first;
+    pthread_mutex_unlock(&slab_central_.lock[cls]);
+}
+
+CSPTR_MALLOC_API
+void *slab_alloc(size_t size) {
+    if (size > SLAB_MAX_SIZE) {
+        s_slab_prefix *raw = malloc(sizeof (s_slab_prefix) + size);
+        if (!raw)
+            return NULL;
+        raw->tag = 0;
+        return raw + 1;
+    }
+
+    const size_t cls = slab_class_of_(size);
+    if (!slab_cache_.head[cls] && !slab_refill_(cls, slab_batch_(cls)))
+        return NULL;
+
+    s_slab_free *blk = slab_cache_.head[cls];
+    slab_cache_.head[cls] = blk->next;
+    --slab_cache_.count[cls];
+    ((s_slab_prefix *) blk - 1)->tag = (uintptr_t) slab_cache_.self | cls;
+    return blk;
+}
+
+void slab_dealloc(void *ptr) {
+    if (!ptr)
+        return;
+
+    s_slab_prefix *raw = (s_slab_prefix *) ptr - 1;
+    const size_t cls = slab_class_(raw);
+    if (!cls) {
+        free(raw);
+        return;
+    }
+
+    s_slab_free *blk = ptr;
+    s_slab_owner *owner = (s_slab_owner *) (raw->tag & ~SLAB_CLASS_MASK_);
+    if (owner != slab_cache_.self) {
+        _Atomic(s_slab_free *) *remote = &owner->remote[cls];
+        blk->next = atomic_load_explicit(remote, memory_order_relaxed);
+        while (!atomic_compare_exchange_weak_explicit(remote, &blk->next, blk,
+                                                      memory_order_release, memory_order_relaxed))
+            ;
+        return;
+    }
+
+    blk->next = slab_cache_.head[cls];
+    slab_cache_.head[cls] = blk;
+    const uint32_t batch = slab_batch_(cls);
+    if (++slab_cache_.count[cls] > 2 * batch)
+        slab_release_(cls, batch);
+}
+
+void *slab_realloc(void *ptr, size_t size) {
+    if (!ptr)
+        return slab_alloc(size);
+
+    s_slab_prefix *raw = (s_slab_prefix *) ptr - 1;
+    const size_t cls = slab_class_(raw);
+    if (!cls) {
+        s_slab_prefix *b = realloc(raw, sizeof (s_slab_prefix) + size);
+        return b ? b + 1 : NULL;
+    }
+
+    const size_t cap = slab_class_size_(cls);
+    if (size <= cap)
+        return ptr;
+
+    void *b = slab_alloc(size);
+    if (!b)
+        return NULL;
+    memcpy(b, ptr, cap);
+    slab_dealloc(ptr);
+    return b;
+}
+
+size_t slab_usable_size(void *ptr) {
+    const size_t cls = slab_class_((s_slab_prefix *) ptr - 1);
+    return cls ? slab_class_size_(cls) : 0;
+}
+
+void slab_thread_flush(void) {
+    for (size_t cls = 1; cls < SLAB_CLASSES; ++cls) {
+        if (slab_cache_.self)
+            slab_collect_(cls);
+        slab_release_(cls, slab_cache_.count[cls]);
+    }
+}
+
+const s_allocator slab_allocator = {slab_alloc, slab_dealloc, slab_realloc, slab_usable_size};
+const s_alloc_handle slab_alloc_handle = SMALLOC_HANDLE_OF(&slab_allocator);
+
+#endif
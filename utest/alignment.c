@@ -0,0 +1,104 @@
+#include "utils.h"
+
+static const float F[] = {1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f, 8.f, 9.f, 10.f, 11.f, 12.f, 13.f};
+
+static bool is_aligned_to(const void *ptr, size_t alignment) {
+    return !((uintptr_t) ptr % alignment);
+}
+
+/* hands out blocks that are only word aligned, moving them to a different
+ * offset on every realloc */
+static void *skewed_place(size_t size, size_t shift) {
+    char *raw = aligned_alloc(64, (size + 64 + 63) & ~(size_t) 63);
+    size_t *b = (size_t *) (raw + 24 + shift);
+    b[-2] = (size_t) raw;
+    b[-1] = size;
+    return b;
+}
+
+static void *skewed_alloc(UNUSED void *ctx, size_t size) {
+    return skewed_place(size, 0);
+}
+
+static void skewed_dealloc(UNUSED void *ctx, void *ptr) {
+    if (ptr) free((void *) ((size_t *) ptr)[-2]);
+}
+
+static void *skewed_realloc(void *ctx, void *ptr, size_t size) {
+    static size_t shift;
+    shift = (shift + 8) % 40;
+    void *b = skewed_place(size, shift);
+    const size_t old = ((size_t *) ptr)[-1];
+    memcpy(b, ptr, old < size ? old : size);
+    skewed_dealloc(ctx, ptr);
+    return b;
+}
+
+static const s_alloc_handle skewed = {skewed_alloc, skewed_dealloc, skewed_realloc, NULL, NULL};
+
+TEST aligned_ptr(void) {
+    smart double *d = unique_ptr(double, 3.5, .alignment = 64, .allocator = &skewed);
+    ASSERT(is_aligned_to(d, 64));
+    ASSERT_EQ(3.5, *d);
+    ASSERT_EQ(NULL, get_smart_ptr_userdata(d));
+
+    smart int *s = shared_ptr(int, 42, .alignment = 32, .allocator = &skewed,
+                              .userdata = { &g_metadata, sizeof(g_metadata) });
+    ASSERT(is_aligned_to(s, 32));
+    autoclean int *s2 = sref(s);
+    ASSERT_EQ(42, *s2);
+    CHECK_CALL(assert_valid_meta(&g_metadata, get_smart_ptr_userdata(s)));
+    PASS();
+}
+
+TEST aligned_arr(void) {
+    smart float *a = unique_arr(float, LEN(F), F, .alignment = 32, .allocator = &skewed);
+    ASSERT(is_aligned_to(a, 32));
+    ASSERT_EQ(LEN(F), static_array.length(a));
+    assert_eq_arrays(F, a);
+    PASS();
+}
+
+TEST alignment_survives_growth(void) {
+    smart float *a = shared_arr(float, 1, .alignment = 64, .allocator = &skewed,
+                                .userdata = { &g_metadata, sizeof(g_metadata) });
+    for (int round = 0; round < 8; ++round) {
+        for (size_t i = 0; i < LEN(F); ++i) {
+            arrappend(a, F[i]);
+            ASSERT(is_aligned_to(a, 64));
+        }
+    }
+    ASSERT_EQ(8 * LEN(F), static_array.length(a));
+    for (size_t i = 0; i < static_array.length(a); ++i)
+        ASSERT_EQ(F[i % LEN(F)], a[i]);
+    CHECK_CALL(assert_valid_meta(&g_metadata, get_smart_ptr_userdata(a)));
+    PASS();
+}
+
+TEST alignment_in_arena(void) {
+    s_arena *arena = sarena_new(512);
+    float *a = unique_arr(float, 2, .alignment = 64, .arena = arena);
+    for (size_t i = 0; i < LEN(F); ++i) {
+        arrappend(a, F[i]);
+        ASSERT(is_aligned_to(a, 64));
+    }
+    assert_eq_arrays(F, a);
+    sarena_free(arena);
+    PASS();
+}
+
+TEST invalid_alignment(void) {
+    ASSERT_EQ(NULL, unique_ptr(int, 1, .alignment = 24));
+    ASSERT_EQ(NULL, unique_ptr(int, 1, .alignment = 2 * SMALLOC_MAX_ALIGNMENT));
+    smart int *p = unique_ptr(int, 1, .alignment = 2);
+    CHECK_CALL(assert_valid_ptr(p));
+    PASS();
+}
+
+GREATEST_SUITE(alignment_suite) {
+    RUN_TEST(aligned_ptr);
+    RUN_TEST(aligned_arr);
+    RUN_TEST(alignment_survives_growth);
+    RUN_TEST(alignment_in_arena);
+    RUN_TEST(invalid_alignment);
+}
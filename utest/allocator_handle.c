@@ -0,0 +1,103 @@
+#include "utils.h"
+#include <pthread.h>
+
+static const int A[] = {1, 3, 5, 7, 9, 2, 4, 6, 8, 10, 11};
+
+typedef struct {
+    int allocs;
+    int deallocs;
+    int reallocs;
+} counting_ctx;
+
+static void *counting_alloc(void *ctx, size_t size) {
+    ++((counting_ctx *) ctx)->allocs;
+    return malloc(size);
+}
+
+static void counting_dealloc(void *ctx, void *ptr) {
+    ++((counting_ctx *) ctx)->deallocs;
+    free(ptr);
+}
+
+static void *counting_realloc(void *ctx, void *ptr, size_t size) {
+    ++((counting_ctx *) ctx)->reallocs;
+    return realloc(ptr, size);
+}
+
+TEST handle_per_call(void) {
+    counting_ctx ctx = {0};
+    const s_alloc_handle handle = {counting_alloc, counting_dealloc, counting_realloc, &ctx, NULL};
+    {
+        smart int *u = unique_ptr(int, 42, .allocator = &handle);
+        CHECK_CALL(assert_valid_ptr(u));
+        smart int *s = shared_ptr(int, 7, .allocator = &handle);
+        autoclean int *s2 = sref(s);
+        smart int *untracked = unique_ptr(int, 1);
+        ASSERT_EQ(2, ctx.allocs);
+    }
+    ASSERT_EQm("Expected sfree to return blocks to their own allocator", 2, ctx.deallocs);
+    PASS();
+}
+
+TEST handle_survives_growth(void) {
+    counting_ctx ctx = {0};
+    const s_alloc_handle handle = {counting_alloc, counting_dealloc, counting_realloc, &ctx, NULL};
+    int *a = shared_arr(int, 1, .allocator = &handle);
+    for (size_t i = 0; i < LEN(A); ++i)
+        arrappend(a, A[i]);
+    assert_eq_arrays(A, a);
+    ASSERT_LT(0, ctx.reallocs);
+    sfree(a);
+    ASSERT_EQ(1, ctx.allocs);
+    ASSERT_EQ(1, ctx.deallocs);
+    PASS();
+}
+
+TEST handle_alloc_failure(void) {
+    const s_alloc_handle failing = {
+        lambda(void*, (UNUSED void *ctx, UNUSED size_t s) { return NULL; }),
+        lambda(void, (UNUSED void *ctx, UNUSED void *ptr) {}),
+        lambda(void*, (UNUSED void *ctx, UNUSED void* p, UNUSED size_t sz) { return NULL; }),
+        NULL, NULL
+    };
+    smart void *ptr = unique_ptr(int, 42, .allocator = &failing);
+    ASSERT_EQm("Expected NULL pointer to be returned.", NULL, ptr);
+    smart int *other = unique_ptr(int, 42);
+    ASSERT_NEQm("Expected the global allocator to be left alone.", NULL, other);
+    PASS();
+}
+
+static void *alloc_on_other_thread(void *arg) {
+    (void) arg;
+    return unique_ptr(int, 7);
+}
+
+TEST handle_thread_default(void) {
+    counting_ctx ctx = {0};
+    const s_alloc_handle handle = {counting_alloc, counting_dealloc, counting_realloc, &ctx, NULL};
+    ASSERT_EQ(&smalloc_default_handle, smalloc_get_allocator());
+
+    const s_alloc_handle *prev = smalloc_set_allocator(&handle);
+    ASSERT_EQ(&smalloc_default_handle, prev);
+    int *mine = unique_ptr(int, 1);
+
+    pthread_t th;
+    void *theirs;
+    pthread_create(&th, NULL, alloc_on_other_thread, NULL);
+    pthread_join(th, &theirs);
+    ASSERT_EQm("Expected other threads to keep their own default", 1, ctx.allocs);
+
+    smalloc_set_allocator(NULL);
+    ASSERT_EQ(&smalloc_default_handle, smalloc_get_allocator());
+    sfree(mine);
+    sfree(theirs);
+    ASSERT_EQ(1, ctx.deallocs);
+    PASS();
+}
+
+GREATEST_SUITE(allocator_handle_suite) {
+    RUN_TEST(handle_per_call);
+    RUN_TEST(handle_survives_growth);
+    RUN_TEST(handle_alloc_failure);
+    RUN_TEST(handle_thread_default);
+}
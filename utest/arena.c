@@ -0,0 +1,83 @@
+#include "utils.h"
+
+static const int A[] = {1, 3, 5, 7, 9, 2, 4, 6, 8, 10, 11};
+
+static int dtor_order[16];
+static size_t dtor_calls;
+
+static void record_dtor(void *ptr, UNUSED void *userdata) {
+    if (dtor_calls < LEN(dtor_order))
+        dtor_order[dtor_calls] = *(int *) ptr;
+    ++dtor_calls;
+}
+
+TEST arena_objects_survive_sfree(void) {
+    s_arena *arena = sarena_new(0);
+    ASSERT_NEQ(NULL, arena);
+    dtor_calls = 0;
+
+    int *u = unique_ptr(int, 1, record_dtor, .arena = arena);
+    CHECK_CALL(assert_valid_ptr(u));
+    int *s = shared_ptr(int, 2, .dtor = record_dtor, .arena = arena);
+    {
+        autoclean int *s2 = sref(s);
+        ASSERT_EQ(2, *s2);
+    }
+    sfree(u);
+    sfree(s);
+    ASSERT_EQm("Expected destructors to wait for the arena reset", 0, dtor_calls);
+
+    sarena_free(arena);
+    ASSERT_EQ(2, dtor_calls);
+    PASS();
+}
+
+TEST arena_reset_runs_dtors_in_order(void) {
+    s_arena *arena = sarena_new(256);
+    dtor_calls = 0;
+    for (int i = 0; i < 10; ++i) {
+        smart int *p = shared_ptr(int, i, record_dtor, .arena = arena);
+        unique_arr(double, 8, .arena = arena);
+        ASSERT_EQ(i, *p);
+    }
+    sarena_reset(arena);
+    ASSERT_EQ(10, dtor_calls);
+    for (int i = 0; i < 10; ++i)
+        ASSERT_EQ(i, dtor_order[i]);
+
+    dtor_calls = 0;
+    unique_ptr(int, 42, record_dtor, .arena = arena);
+    sarena_free(arena);
+    ASSERT_EQ(1, dtor_calls);
+    ASSERT_EQ(42, dtor_order[0]);
+    PASS();
+}
+
+TEST arena_array_grows(void) {
+    s_arena *arena = sarena_new(128);
+    int sum = 0;
+    f_destructor dtor = lambda(void, (void *ptr, UNUSED void *userdata) { sum += *(int *) ptr; });
+
+    int *a = shared_arr(int, 2, .dtor = dtor, .arena = arena);
+    for (size_t i = 0; i < LEN(A); ++i)
+        arrappend(a, A[i]);
+    ASSERT_EQ(LEN(A), static_array.length(a));
+    assert_eq_arrays(A, a);
+    sfree(a);
+
+    int large[1024] = {0};
+    int *b = unique_arr(int, LEN(large), large, .arena = arena);
+    ASSERT_EQ(LEN(large), static_array.length(b));
+
+    sarena_free(arena);
+    int expected = 0;
+    for (size_t i = 0; i < LEN(A); ++i) expected += A[i];
+    ASSERT_EQm("Expected the grown array to be destroyed exactly once", expected, sum);
+    PASS();
+}
+
+GREATEST_SUITE(arena_suite) {
+    RUN_TEST(arena_objects_survive_sfree);
+    RUN_TEST(arena_reset_runs_dtors_in_order);
+    RUN_TEST(arena_array_grows);
+}
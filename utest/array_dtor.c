@@ -0,0 +1,118 @@
+#include "utils.h"
+
+static const int A[] = {1, 3, 5, 7, 9, 2, 4, 6, 8, 10, 11};
+
+static int item_sum;
+static size_t item_calls;
+
+static void item_dtor(void *ptr, UNUSED void *userdata) {
+    item_sum += *(int *) ptr;
+    ++item_calls;
+}
+
+static struct {
+    size_t calls;
+    size_t count;
+    size_t item_size;
+    int sum;
+    void *base;
+    void *userdata;
+} batch;
+
+static void batch_dtor(void *base, size_t count, size_t item_size, void *userdata) {
+    ++batch.calls;
+    batch.count += count;
+    batch.item_size = item_size;
+    batch.base = base;
+    batch.userdata = userdata;
+    for (size_t i = 0; i < count; ++i)
+        batch.sum += ((int *) base)[i];
+}
+
+static void reset_(void) {
+    item_sum = 0;
+    item_calls = 0;
+    memset(&batch, 0, sizeof batch);
+}
+
+static int sum_(const int *a, size_t n) {
+    int sum = 0;
+    for (size_t i = 0; i < n; ++i)
+        sum += a[i];
+    return sum;
+}
+
+TEST teardown_calls_array_dtor_once(void) {
+    reset_();
+    int *a = unique_arr(int, LEN(A), A, .array_dtor = batch_dtor,
+                        .userdata = {&g_metadata, sizeof g_metadata});
+    void *userdata = static_array.userdata(a);
+    sfree(a);
+    ASSERT_EQ(1, batch.calls);
+    ASSERT_EQ(LEN(A), batch.count);
+    ASSERT_EQ(sizeof (int), batch.item_size);
+    ASSERT_EQ(userdata, batch.userdata);
+    ASSERT_EQ(sum_(A, LEN(A)), batch.sum);
+    PASS();
+}
+
+TEST deletes_destroy_items(void) {
+    reset_();
+    int *a = shared_arr(int, LEN(A), A, item_dtor);
+    arrdel(a, 0);
+    ASSERT_EQ(1, item_calls);
+    ASSERT_EQ(A[0], item_sum);
+    arrdeln(a, 1, 3);
+    ASSERT_EQ(4, item_calls);
+    ASSERT_EQ(A[0] + A[2] + A[3] + A[4], item_sum);
+    arrdelswap(a, 0);
+    ASSERT_EQ(5, item_calls);
+    ASSERT_EQ(A[0] + A[1] + A[2] + A[3] + A[4], item_sum);
+
+    // a popped item belongs to the caller
+    const int last = arrpop(a);
+    ASSERT_EQ(A[LEN(A) - 2], last);
+    ASSERT_EQ(5, item_calls);
+
+    const size_t left = arrlenu(a);
+    sfree(a);
+    ASSERT_EQ(5 + left, item_calls);
+    PASS();
+}
+
+TEST deln_calls_array_dtor_once(void) {
+    reset_();
+    int *a = shared_arr(int, LEN(A), A, .array_dtor = batch_dtor);
+    arrdeln(a, 2, 4);
+    ASSERT_EQ(1, batch.calls);
+    ASSERT_EQ(4, batch.count);
+    ASSERT_EQ(sum_(A + 2, 4), batch.sum);
+    ASSERT_EQ(LEN(A) - 4, arrlenu(a));
+    ASSERT_EQ(A[6], a[2]);
+
+    ASSERT_EQ(0, arr_remove_if(a, lambda(int, (UNUSED const void *item, UNUSED void *ctx) { return 0; }), NULL));
+    ASSERT_EQ(1, batch.calls);
+    sfree(a);
+    ASSERT_EQ(2, batch.calls);
+    ASSERT_EQ(sum_(A, LEN(A)), batch.sum);
+    PASS();
+}
+
+TEST trivially_destructible(void) {
+    reset_();
+    int *a = unique_arr(int, LEN(A), A);
+    arrdel(a, 0);
+    arrdeln(a, 0, 2);
+    arrdelswap(a, 0);
+    sfree(a);
+    ASSERT_EQ(0, item_calls);
+    ASSERT_EQ(0, batch.calls);
+    PASS();
+}
+
+GREATEST_SUITE(array_dtor_suite) {
+    RUN_TEST(teardown_calls_array_dtor_once);
+    RUN_TEST(deletes_destroy_items);
+    RUN_TEST(deln_calls_array_dtor_once);
+    RUN_TEST(trivially_destructible);
+}
@@ -0,0 +1,185 @@
+#include "utils.h"
+
+typedef struct {
+    int reallocs;
+    size_t round;   // 0: exact blocks, no usable_size
+    int fail;       // reallocs return NULL
+} growth_ctx;
+
+/* blocks carry their rounded size in front, so usable_size can report it */
+static size_t rounded_(const growth_ctx *ctx, size_t size) {
+    return ctx->round ? (size + ctx->round - 1) / ctx->round * ctx->round : size;
+}
+
+static void *growth_alloc(void *ctx, size_t size) {
+    size_t *raw = malloc(sizeof (size_t) + rounded_(ctx, size));
+    if (!raw)
+        return NULL;
+    *raw = rounded_(ctx, size);
+    return raw + 1;
+}
+
+static void growth_dealloc(void *ctx, void *ptr) {
+    (void) ctx;
+    if (ptr)
+        free((size_t *) ptr - 1);
+}
+
+static void *growth_realloc(void *ctx, void *ptr, size_t size) {
+    ++((growth_ctx *) ctx)->reallocs;
+    if (((growth_ctx *) ctx)->fail)
+        return NULL;
+    size_t *raw = realloc((size_t *) ptr - 1, sizeof (size_t) + rounded_(ctx, size));
+    if (!raw)
+        return NULL;
+    *raw = rounded_(ctx, size);
+    return raw + 1;
+}
+
+static size_t growth_usable_size(void *ctx, void *ptr) {
+    return ((growth_ctx *) ctx)->round ? ((size_t *) ptr)[-1] : 0;
+}
+
+static int append_reallocs_(enum arr_growth growth, size_t n) {
+    growth_ctx ctx = {0};
+    const s_alloc_handle handle = {growth_alloc, growth_dealloc, growth_realloc, &ctx, growth_usable_size};
+    int *a = unique_arr(int, 1, .allocator = &handle);
+    arrsetgrowth(a, growth);
+    for (size_t i = 0; i < n; ++i)
+        arrappend(a, (int) i);
+    for (size_t i = 0; i < n; ++i)
+        if (a[i] != (int) i)
+            ctx.reallocs = -1;
+    sfree(a);
+    return ctx.reallocs;
+}
+
+TEST growth_policies(void) {
+    // 1 -> 4 -> 8 -> ... -> 128
+    ASSERT_EQ(6, append_reallocs_(ARR_GROW_DOUBLE, 100));
+    // 1 -> 4 -> 6 -> 9 -> 13 -> 19 -> 28 -> 42 -> 63 -> 94 -> 141
+    ASSERT_EQ(10, append_reallocs_(ARR_GROW_1_5X, 100));
+    ASSERT_EQ(99, append_reallocs_(ARR_GROW_EXACT, 100));
+    // the first page holds them all
+    ASSERT_EQ(1, append_reallocs_(ARR_GROW_PAGE, 100));
+    PASS();
+}
+
+TEST page_growth_fills_pages(void) {
+    growth_ctx ctx = {0};
+    const s_alloc_handle handle = {growth_alloc, growth_dealloc, growth_realloc, &ctx, growth_usable_size};
+    int *a = unique_arr(int, 1, .allocator = &handle);
+    arrsetgrowth(a, ARR_GROW_PAGE);
+    arrappend(a, 1);
+    arrappend(a, 2);
+    ASSERT_LT(SMALLOC_GROW_PAGE_SIZE / sizeof (int) - 64, arrcap(a));
+    ASSERT_GTE(SMALLOC_GROW_PAGE_SIZE / sizeof (int), arrcap(a));
+    sfree(a);
+    PASS();
+}
+
+TEST reserve_then_append(void) {
+    growth_ctx ctx = {0};
+    const s_alloc_handle handle = {growth_alloc, growth_dealloc, growth_realloc, &ctx, growth_usable_size};
+    int *a = unique_arr(int, 1, .allocator = &handle);
+    arrreserve(a, 100);
+    ASSERT_EQ(100, arrcap(a));
+    ASSERT_EQ(0, arrlenu(a));
+    ASSERT_EQ(1, ctx.reallocs);
+    for (int i = 0; i < 100; ++i)
+        arrappend(a, i);
+    ASSERT_EQ(1, ctx.reallocs);
+    // already large enough
+    arrreserve(a, 50);
+    ASSERT_EQ(1, ctx.reallocs);
+    ASSERT_EQ(99, arrlast(a));
+    sfree(a);
+    PASS();
+}
+
+TEST failed_reserve_keeps_array(void) {
+    growth_ctx ctx = {0};
+    const s_alloc_handle handle = {growth_alloc, growth_dealloc, growth_realloc, &ctx, growth_usable_size};
+    int *a = unique_arr(int, 1, .allocator = &handle);
+    arrappend(a, 7);
+    int *const before = a;
+    ctx.fail = 1;
+    arrreserve(a, 100);
+    ASSERT_EQ(before, a);
+    ASSERT_EQ(1, arrcap(a));
+    ASSERT_EQ(7, a[0]);
+    ctx.fail = 0;
+    arrreserve(a, 100);
+    ASSERT_EQ(100, arrcap(a));
+    sfree(a);
+    PASS();
+}
+
+TEST shrink_to_length(void) {
+    growth_ctx ctx = {0};
+    const s_alloc_handle handle = {growth_alloc, growth_dealloc, growth_realloc, &ctx, growth_usable_size};
+    int *a = unique_arr(int, 1, .allocator = &handle, .userdata = {&g_metadata, sizeof g_metadata});
+    for (int i = 0; i < 100; ++i)
+        arrappend(a, i);
+    ASSERT_EQ(128, arrcap(a));
+    const int reallocs = ctx.reallocs;
+
+    arrshrink(a);
+    ASSERT_EQ(100, arrcap(a));
+    ASSERT_EQ(100, arrlenu(a));
+    ASSERT_EQ(reallocs + 1, ctx.reallocs);
+    for (int i = 0; i < 100; ++i)
+        ASSERT_EQ(i, a[i]);
+    ASSERT_MEM_EQ(&g_metadata, static_array.userdata(a), sizeof g_metadata);
+
+    arrshrink(a);
+    ASSERT_EQ(reallocs + 1, ctx.reallocs);
+    arrappend(a, 100);
+    ASSERT_EQ(200, arrcap(a));
+    sfree(a);
+    PASS();
+}
+
+TEST usable_size_counts_as_capacity(void) {
+    growth_ctx ctx = {.round = 256};
+    const s_alloc_handle handle = {growth_alloc, growth_dealloc, growth_realloc, &ctx, growth_usable_size};
+    int *a = unique_arr(int, 1, .allocator = &handle);
+    arrappend(a, 0);
+    arrappend(a, 1);
+    ASSERT_EQ(1, ctx.reallocs);
+    // asked for 4, the rest of the 256 bytes is there too
+    const size_t cap = arrcap(a);
+    ASSERT_LT(4, cap);
+    ASSERT_GTE(256 / sizeof (int), cap);
+    for (size_t i = 2; i < cap; ++i)
+        arrappend(a, (int) i);
+    ASSERT_EQ(1, ctx.reallocs);
+    for (size_t i = 0; i < cap; ++i)
+        ASSERT_EQ((int) i, a[i]);
+    sfree(a);
+    PASS();
+}
+
+TEST aligned_shrink(void) {
+    int *a = unique_arr(int, 1, .alignment = 64);
+    for (int i = 0; i < 40; ++i)
+        arrappend(a, i);
+    arrreserve(a, 1000);
+    arrshrink(a);
+    ASSERT_EQ(40, arrcap(a));
+    ASSERT_EQ(0, (uintptr_t) a % 64);
+    for (int i = 0; i < 40; ++i)
+        ASSERT_EQ(i, a[i]);
+    sfree(a);
+    PASS();
+}
+
+GREATEST_SUITE(array_growth_suite) {
+    RUN_TEST(growth_policies);
+    RUN_TEST(page_growth_fills_pages);
+    RUN_TEST(reserve_then_append);
+    RUN_TEST(failed_reserve_keeps_array);
+    RUN_TEST(shrink_to_length);
+    RUN_TEST(usable_size_counts_as_capacity);
+    RUN_TEST(aligned_shrink);
+}
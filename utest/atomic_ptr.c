@@ -0,0 +1,124 @@
+#include "utils.h"
+#include "../atomic_ptr.h"
+#include <pthread.h>
+
+static atomic_int dtor_calls;
+
+struct snapshot {
+    int version;
+    int twice;
+};
+
+static void poison_dtor(void *ptr, UNUSED void *userdata) {
+    *(struct snapshot *) ptr = (struct snapshot) { -1, 0 };
+    ++dtor_calls;
+}
+
+static struct snapshot *make_snapshot(int version) {
+    return shared_ptr(struct snapshot, { version, 2 * version }, poison_dtor);
+}
+
+TEST atomic_load_store(void) {
+    dtor_calls = 0;
+    s_atomic_ptr slot = SATOMIC_PTR_INIT;
+    ASSERT_EQ(NULL, satomic_load(&slot));
+
+    struct snapshot *a = make_snapshot(1);
+    satomic_store(&slot, a);
+    sfree(a);
+    ASSERT_EQm("Expected the slot to keep its own reference", 0, dtor_calls);
+
+    struct snapshot *got = satomic_load(&slot);
+    ASSERT_EQ(1, got->version);
+    satomic_store(&slot, NULL);
+    ASSERT_EQm("Expected the loaded reference to outlive the slot's", 0, dtor_calls);
+    sfree(got);
+    ASSERT_EQ(1, dtor_calls);
+    PASS();
+}
+
+TEST atomic_exchange_and_cas(void) {
+    dtor_calls = 0;
+    s_atomic_ptr slot = SATOMIC_PTR_INIT;
+    struct snapshot *a = make_snapshot(1), *b = make_snapshot(2), *c = make_snapshot(3);
+    satomic_store(&slot, a);
+
+    struct snapshot *old = satomic_exchange(&slot, b);
+    ASSERT_EQ(a, old);
+    sfree(old);
+
+    void *expected = sref(a);
+    ASSERT_FALSE(satomic_compare_exchange(&slot, &expected, c));
+    ASSERTm("Expected a failed exchange to load the current value", expected == b);
+    ASSERT(satomic_compare_exchange(&slot, &expected, c));
+    sfree(expected);
+
+    struct snapshot *now = satomic_load(&slot);
+    ASSERT_EQ(3, now->version);
+    sfree(now);
+
+    sfree(a);
+    sfree(b);
+    sfree(c);
+    ASSERT_EQm("Expected only the slot's object to be alive", 2, dtor_calls);
+    satomic_store(&slot, NULL);
+    ASSERT_EQ(3, dtor_calls);
+    PASS();
+}
+
+static s_atomic_ptr shared_slot = SATOMIC_PTR_INIT;
+static atomic_int writer_done;
+
+static void *reader(void *arg) {
+    int *torn = arg;
+    int last = 0;
+    while (!writer_done) {
+        struct snapshot *s = satomic_load(&shared_slot);
+        if (s->twice != 2 * s->version || s->version < last)
+            ++*torn;
+        last = s->version;
+        sfree(s);
+    }
+    return NULL;
+}
+
+TEST atomic_concurrent_publish(void) {
+    enum { VERSIONS = 20000 };
+    dtor_calls = 0;
+    writer_done = 0;
+    struct snapshot *first = make_snapshot(0);
+    satomic_store(&shared_slot, first);
+    sfree(first);
+
+    pthread_t t[3];
+    int torn[LEN(t)] = {0};
+    for (size_t i = 0; i < LEN(t); ++i)
+        pthread_create(&t[i], NULL, reader, &torn[i]);
+
+    for (int v = 1; v < VERSIONS; ++v) {
+        struct snapshot *next = make_snapshot(v);
+        if (v & 1) {
+            satomic_store(&shared_slot, next);
+        } else {
+            void *expected = satomic_load(&shared_slot);
+            while (!satomic_compare_exchange(&shared_slot, &expected, next))
+                ;
+            sfree(expected);
+        }
+        sfree(next);
+    }
+    writer_done = 1;
+    for (size_t i = 0; i < LEN(t); ++i) {
+        pthread_join(t[i], NULL);
+        ASSERT_EQm("Expected readers to only see live, newer snapshots", 0, torn[i]);
+    }
+    satomic_store(&shared_slot, NULL);
+    ASSERT_EQ(VERSIONS, dtor_calls);
+    PASS();
+}
+
+GREATEST_SUITE(atomic_ptr_suite) {
+    RUN_TEST(atomic_load_store);
+    RUN_TEST(atomic_exchange_and_cas);
+    RUN_TEST(atomic_concurrent_publish);
+}
@@ -0,0 +1,97 @@
+#include "utils.h"
+
+static int dtor_calls;
+
+static void count_dtor(UNUSED void *ptr, UNUSED void *userdata) {
+    ++dtor_calls;
+}
+
+TEST drain_releases_registered(void) {
+    dtor_calls = 0;
+    int *p = sautorelease(shared_ptr(int, 1, count_dtor));
+    int *q = sautorelease(unique_ptr(int, 2, count_dtor));
+    ASSERT_EQ(3, *p + *q);
+    ASSERT_EQ(0, dtor_calls);
+    csptr_pool_drain();
+    ASSERT_EQ(2, dtor_calls);
+    // nothing left to drain
+    csptr_pool_drain();
+    ASSERT_EQ(2, dtor_calls);
+    ASSERT_EQ(NULL, sautorelease(NULL));
+    PASS();
+}
+
+TEST pool_keeps_reference(void) {
+    dtor_calls = 0;
+    int *p = shared_ptr(int, 1, count_dtor);
+    for (int i = 0; i < 3; ++i)
+        sautorelease(sref(p));
+    csptr_pool_drain();
+    ASSERT_EQ(0, dtor_calls);
+    ASSERT_EQ(1, *p);
+    sfree(p);
+    ASSERT_EQ(1, dtor_calls);
+    PASS();
+}
+
+TEST nested_pools(void) {
+    dtor_calls = 0;
+    sautorelease(shared_ptr(int, 1, count_dtor));
+    {
+        autorelease_pool;
+        sautorelease(shared_ptr(int, 2, count_dtor));
+        {
+            autorelease_pool;
+            sautorelease(shared_ptr(int, 3, count_dtor));
+            sautorelease(shared_ptr(int, 4, count_dtor));
+        }
+        ASSERT_EQ(2, dtor_calls);
+        // drains the innermost pool only
+        csptr_pool_drain();
+        ASSERT_EQ(3, dtor_calls);
+        sautorelease(shared_ptr(int, 5, count_dtor));
+    }
+    ASSERT_EQ(4, dtor_calls);
+    csptr_pool_drain();
+    ASSERT_EQ(5, dtor_calls);
+    PASS();
+}
+
+static void register_more(void *ptr, UNUSED void *userdata) {
+    ++dtor_calls;
+    const int depth = *(int *) ptr;
+    if (depth)
+        sautorelease(shared_ptr(int, depth - 1, register_more));
+}
+
+TEST drain_picks_up_dtor_registrations(void) {
+    dtor_calls = 0;
+    {
+        autorelease_pool;
+        sautorelease(shared_ptr(int, 0, count_dtor));
+        sautorelease(shared_ptr(int, 10, register_more));
+    }
+    ASSERT_EQ(12, dtor_calls);
+    PASS();
+}
+
+TEST drain_many(void) {
+    dtor_calls = 0;
+    {
+        autorelease_pool;
+        for (int i = 0; i < 1000; ++i)
+            sautorelease(shared_ptr(int, i, count_dtor));
+        int *a = sautorelease(unique_arr(int, 8));
+        arrappend(a, 1);
+    }
+    ASSERT_EQ(1000, dtor_calls);
+    PASS();
+}
+
+GREATEST_SUITE(autorelease_suite) {
+    RUN_TEST(drain_releases_registered);
+    RUN_TEST(pool_keeps_reference);
+    RUN_TEST(nested_pools);
+    RUN_TEST(drain_picks_up_dtor_registrations);
+    RUN_TEST(drain_many);
+}
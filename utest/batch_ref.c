@@ -0,0 +1,79 @@
+#include "utils.h"
+
+static size_t dtor_calls;
+
+static void count_dtor(UNUSED void *ptr, UNUSED void *userdata) {
+    ++dtor_calls;
+}
+
+TEST sref_n_adds_references(void) {
+    dtor_calls = 0;
+    int *p = shared_ptr(int, 3, count_dtor);
+    ASSERT_EQ(p, sref_n(p, 10));
+    for (int i = 0; i < 10; ++i)
+        sfree(p);
+    ASSERT_EQ(0, dtor_calls);
+    sfree(p);
+    ASSERT_EQ(1, dtor_calls);
+
+    int *l = shared_local_ptr(int, 4, count_dtor);
+    int *b = shared_biased_ptr(int, 5, count_dtor);
+    sref_n(l, 3);
+    sref_n(b, 3);
+    for (int i = 0; i < 4; ++i) {
+        sfree(l);
+        sfree(b);
+    }
+    ASSERT_EQ(3, dtor_calls);
+    PASS();
+}
+
+TEST sfree_many_mixed(void) {
+    dtor_calls = 0;
+    void *ptrs[200];
+    size_t n = 0;
+
+    // fanned-out copies next to each other, as after sref_n
+    int *fan = sref_n(shared_ptr(int, 1, count_dtor), 7);
+    for (int i = 0; i < 8; ++i)
+        ptrs[n++] = fan;
+    ptrs[n++] = NULL;
+    // more dead blocks than one internal batch
+    for (; n < 150; ++n)
+        ptrs[n] = (n & 1) ? (void *) unique_ptr(int, 2, count_dtor)
+                          : (void *) shared_arr(long, 2, ((long[]) {1, 2}), count_dtor);
+    // copies spread out, plus kinds that take the slow path
+    int *spread = sref(shared_ptr(int, 3, count_dtor));
+    ptrs[n++] = spread;
+    ptrs[n++] = shared_local_ptr(int, 4, count_dtor);
+    ptrs[n++] = spread;
+    ptrs[n++] = sref_n(shared_biased_ptr(int, 5, count_dtor), 1);
+    ptrs[n] = ptrs[n - 1];
+    ++n;
+
+    size_t expected = 1 + 1 + 1 + 1;
+    for (size_t i = 9; i < 150; ++i)
+        expected += (i & 1) ? 1 : 2;
+
+    sfree_many(ptrs, n);
+    ASSERT_EQ(expected, dtor_calls);
+    PASS();
+}
+
+TEST sfree_many_keeps_live(void) {
+    dtor_calls = 0;
+    int *p = sref_n(shared_ptr(int, 1, count_dtor), 2);
+    void *ptrs[] = {p, p};
+    sfree_many(ptrs, LEN(ptrs));
+    ASSERT_EQ(0, dtor_calls);
+    ASSERT_EQ(1, *p);
+    sfree_many((void *[]) {p}, 1);
+    ASSERT_EQ(1, dtor_calls);
+    PASS();
+}
+
+GREATEST_SUITE(batch_ref_suite) {
+    RUN_TEST(sref_n_adds_references);
+    RUN_TEST(sfree_many_mixed);
+    RUN_TEST(sfree_many_keeps_live);
+}
@@ -0,0 +1,115 @@
+#include "utils.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+static atomic_int dtor_calls;
+
+static void count_dtor(UNUSED void *ptr, UNUSED void *userdata) {
+    ++dtor_calls;
+}
+
+static void *drop(void *ptr) {
+    sfree(ptr);
+    return NULL;
+}
+
+TEST biased_owner_only(void) {
+    dtor_calls = 0;
+    int *p = shared_biased_ptr(int, 7, count_dtor);
+    CHECK_CALL(assert_valid_ptr(p));
+    for (int i = 0; i < 100; ++i)
+        sref(p);
+    for (int i = 0; i < 100; ++i)
+        sfree(p);
+    ASSERT_EQ(0, dtor_calls);
+    sfree(p);
+    ASSERT_EQ(1, dtor_calls);
+    PASS();
+}
+
+TEST biased_last_drop_on_owner(void) {
+    dtor_calls = 0;
+    int *p = shared_biased_ptr(int, 7, count_dtor);
+    pthread_t t;
+    pthread_create(&t, NULL, drop, sref(p));
+    pthread_join(t, NULL);
+    ASSERTm("Expected the owner to still hold the object", dtor_calls == 0);
+    sbiased_collect();
+    ASSERT_EQ(0, dtor_calls);
+    ASSERT_EQ(7, *p);
+    sfree(p);
+    ASSERT_EQ(1, dtor_calls);
+    PASS();
+}
+
+TEST biased_last_drop_on_worker(void) {
+    dtor_calls = 0;
+    int *p = shared_biased_ptr(int, 7, count_dtor);
+    sref(p);
+    sfree(p);
+    pthread_t t;
+    pthread_create(&t, NULL, drop, p);
+    pthread_join(t, NULL);
+    ASSERTm("Expected the object to wait for its owner", dtor_calls == 0);
+    sbiased_collect();
+    ASSERT_EQ(1, dtor_calls);
+    PASS();
+}
+
+static void *alloc_and_exit(void *arg) {
+    (void) arg;
+    int *p = shared_biased_ptr(int, 9, count_dtor);
+    sref(p);
+    sfree(p);
+    return p;
+}
+
+TEST biased_owner_exited(void) {
+    dtor_calls = 0;
+    pthread_t t;
+    int *p;
+    pthread_create(&t, NULL, alloc_and_exit, NULL);
+    pthread_join(t, (void **) &p);
+    ASSERT_EQ(9, *p);
+    sref(p);
+    sfree(p);
+    ASSERT_EQ(0, dtor_calls);
+    sfree(p);
+    ASSERT_EQm("Expected the last foreign drop to free an orphan", 1, dtor_calls);
+    PASS();
+}
+
+static void *churn(void *ptr) {
+    for (int i = 0; i < 100000; ++i) {
+        sref(ptr);
+        sfree(ptr);
+    }
+    sfree(ptr);
+    return NULL;
+}
+
+TEST biased_concurrent_churn(void) {
+    dtor_calls = 0;
+    int *p = shared_biased_arr(int, 4, (int[4]) {0}, count_dtor);
+    pthread_t t[4];
+    for (size_t i = 0; i < LEN(t); ++i)
+        pthread_create(&t[i], NULL, churn, sref(p));
+    for (int i = 0; i < 100000; ++i) {
+        sref(p);
+        sfree(p);
+    }
+    sfree(p);
+    for (size_t i = 0; i < LEN(t); ++i)
+        pthread_join(t[i], NULL);
+    sbiased_collect();
+    ASSERT_EQ_FMTm("Expected one destructor call per element", 4, (int) dtor_calls, "%d");
+    PASS();
+}
+
+GREATEST_SUITE(biased_refcount_suite) {
+    RUN_TEST(biased_owner_only);
+    RUN_TEST(biased_last_drop_on_owner);
+    RUN_TEST(biased_last_drop_on_worker);
+    RUN_TEST(biased_owner_exited);
+    RUN_TEST(biased_concurrent_churn);
+}
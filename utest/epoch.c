@@ -0,0 +1,163 @@
+#include "utils.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <limits.h>
+#include <time.h>
+
+static atomic_int dtor_calls;
+
+struct snapshot {
+    int version;
+    int twice;
+};
+
+static void poison_dtor(void *ptr, UNUSED void *userdata) {
+    *(struct snapshot *) ptr = (struct snapshot) { -1, 0 };
+    ++dtor_calls;
+}
+
+static void count_dtor(UNUSED void *ptr, UNUSED void *userdata) {
+    ++dtor_calls;
+}
+
+static pthread_barrier_t step;
+static int seen_version;
+
+static void *hold_epoch(void *arg) {
+    struct snapshot *s = arg;
+    sepoch_enter();
+    pthread_barrier_wait(&step);
+    // main drops the last reference here
+    pthread_barrier_wait(&step);
+    sepoch_enter();
+    seen_version = s->version;
+    sepoch_leave();
+    sepoch_leave();
+    return NULL;
+}
+
+TEST epoch_defers_destruction(void) {
+    dtor_calls = 0;
+    struct snapshot *s = shared_epoch_ptr(struct snapshot, { 7, 0 }, poison_dtor);
+    pthread_t t;
+    pthread_barrier_init(&step, NULL, 2);
+    pthread_create(&t, NULL, hold_epoch, s);
+    pthread_barrier_wait(&step);
+    sfree(s);
+    ASSERT_EQm("Expected the reader to keep the object alive", 0, dtor_calls);
+    pthread_barrier_wait(&step);
+    pthread_join(t, NULL);
+    pthread_barrier_destroy(&step);
+    ASSERT_EQ(7, seen_version);
+
+    sepoch_flush();
+    ASSERT_EQ(1, dtor_calls);
+    PASS();
+}
+
+TEST epoch_refcount_still_applies(void) {
+    dtor_calls = 0;
+    int *a = shared_epoch_arr(int, 3, ((int[]) {1, 2, 3}), count_dtor);
+    sref(a);
+    sfree(a);
+    sepoch_flush();
+    ASSERT_EQm("Expected a live reference to keep the object", 0, dtor_calls);
+    ASSERT_EQ(3, a[2]);
+    sfree(a);
+    sepoch_flush();
+    ASSERT_EQm("Expected one destructor call per element", 3, dtor_calls);
+    PASS();
+}
+
+static _Atomic(struct snapshot *) current;
+static atomic_int writer_done;
+
+static void *reader(void *arg) {
+    int *torn = arg;
+    while (!writer_done) {
+        sepoch_enter();
+        struct snapshot *s = atomic_load(&current);
+        if (s->twice != 2 * s->version)
+            ++*torn;
+        sepoch_leave();
+    }
+    return NULL;
+}
+
+TEST epoch_concurrent_readers(void) {
+    enum { VERSIONS = 20000 };
+    dtor_calls = 0;
+    writer_done = 0;
+    atomic_store(&current, shared_epoch_ptr(struct snapshot, { 0, 0 }, poison_dtor));
+
+    pthread_t t[4];
+    int torn[LEN(t)] = {0};
+    for (size_t i = 0; i < LEN(t); ++i)
+        pthread_create(&t[i], NULL, reader, &torn[i]);
+    for (int v = 1; v < VERSIONS; ++v)
+        sfree(atomic_exchange(&current, shared_epoch_ptr(struct snapshot, { v, 2 * v }, poison_dtor)));
+    writer_done = 1;
+    for (size_t i = 0; i < LEN(t); ++i) {
+        pthread_join(t[i], NULL);
+        ASSERT_EQm("Expected readers to only see live snapshots", 0, torn[i]);
+    }
+    sfree(atomic_exchange(&current, NULL));
+    sepoch_flush();
+    ASSERT_EQ(VERSIONS, dtor_calls);
+    PASS();
+}
+
+TEST epoch_survives_counter_wrap(void) {
+    sepoch_flush();
+    csptr_test_epoch_seed(UINT_MAX);
+    dtor_calls = 0;
+    sepoch_enter();
+    sfree(shared_epoch_ptr(int, 1, count_dtor));
+    // enough retirements to advance from UINT_MAX to 0
+    for (int i = 0; i < SEPOCH_BATCH; ++i)
+        sfree(shared_epoch_ptr(int, i));
+    ASSERT_EQm("Expected the wrap to keep the reader's object", 0, dtor_calls);
+    sepoch_leave();
+    sepoch_flush();
+    ASSERT_EQ(1, dtor_calls);
+    PASS();
+}
+
+static atomic_int reader_left;
+
+static void *hold_then_leave(UNUSED void *arg) {
+    sepoch_enter();
+    pthread_barrier_wait(&step);
+    // give the retire below time to free the object too early
+    nanosleep(&(struct timespec) {.tv_nsec = 50 * 1000 * 1000}, NULL);
+    reader_left = 1;
+    sepoch_leave();
+    return NULL;
+}
+
+TEST epoch_retire_without_node_waits(void) {
+    sepoch_flush();
+    dtor_calls = 0;
+    reader_left = 0;
+    int *p = shared_epoch_ptr(int, 1, count_dtor);
+    pthread_t t;
+    pthread_barrier_init(&step, NULL, 2);
+    pthread_create(&t, NULL, hold_then_leave, NULL);
+    pthread_barrier_wait(&step);
+    // nothing else is pending: the retire has to wait on the reader itself
+    csptr_test_epoch_fail_nodes(1);
+    sfree(p);
+    ASSERT_EQm("Expected the reader to have left first", 1, reader_left);
+    ASSERT_EQ(1, dtor_calls);
+    pthread_join(t, NULL);
+    pthread_barrier_destroy(&step);
+    PASS();
+}
+
+GREATEST_SUITE(epoch_suite) {
+    RUN_TEST(epoch_defers_destruction);
+    RUN_TEST(epoch_refcount_still_applies);
+    RUN_TEST(epoch_concurrent_readers);
+    RUN_TEST(epoch_survives_counter_wrap);
+    RUN_TEST(epoch_retire_without_node_waits);
+}
@@ -0,0 +1,99 @@
+#include "utils.h"
+
+/* smalloc_fast_ is only picked by smart_ptr when the arguments fold at
+ * compile time; the suite runs unoptimized, so it is called directly */
+
+typedef struct {
+    int id;
+    double weight;
+} item;
+
+static size_t dtor_calls;
+
+static void count_dtor(UNUSED void *ptr, UNUSED void *userdata) {
+    ++dtor_calls;
+}
+
+static size_t deallocs;
+
+static void *plain_alloc(UNUSED void *ctx, size_t size) {
+    return malloc(size);
+}
+
+static void counting_dealloc(UNUSED void *ctx, void *ptr) {
+    ++deallocs;
+    free(ptr);
+}
+
+static void *plain_realloc(UNUSED void *ctx, void *ptr, size_t size) {
+    return realloc(ptr, size);
+}
+
+static const s_alloc_handle counting = {plain_alloc, counting_dealloc, plain_realloc, NULL, NULL};
+
+TEST fast_unique(void) {
+    const item value = {.id = 7, .weight = 2.5};
+    item *p = smalloc_fast_(sizeof (item), UNIQUE, NULL, &value);
+    CHECK_CALL(assert_valid_ptr(p));
+    ASSERT_EQ(7, p->id);
+    ASSERT_EQ(2.5, p->weight);
+    ASSERT_EQ(NULL, static_array.userdata(p));
+    ASSERT_EQ(1, static_array.length(p));
+    sfree(p);
+    PASS();
+}
+
+TEST fast_with_dtor(void) {
+    const int value = 42;
+    dtor_calls = 0;
+    int *u = smalloc_fast_(sizeof (int), UNIQUE, count_dtor, &value);
+    int *s = smalloc_fast_(sizeof (int), SHARED, count_dtor, &value);
+    ASSERT_EQ(42, *u);
+    ASSERT_EQ(42, *s);
+    sfree(u);
+    ASSERT_EQ(1, dtor_calls);
+
+    sref(s);
+    sfree(s);
+    ASSERT_EQ(1, dtor_calls);
+    s_weak *w = sweak(s);
+    sfree(s);
+    ASSERT_EQ(2, dtor_calls);
+    ASSERT_EQ(NULL, slock(w));
+    sweak_free(w);
+    PASS();
+}
+
+TEST fast_honours_thread_allocator(void) {
+    const int value = 1;
+    deallocs = 0;
+    const s_alloc_handle *prev = smalloc_set_allocator(&counting);
+    int *p = smalloc_fast_(sizeof (int), UNIQUE, NULL, &value);
+    smalloc_set_allocator(prev);
+    ASSERT_EQ(1, *p);
+    sfree(p);
+    ASSERT_EQ(1, deallocs);
+    PASS();
+}
+
+TEST inline_sfree_uses_block_allocator(void) {
+    deallocs = 0;
+    int *u = unique_ptr(int, 3, .allocator = &counting);
+    int *a = unique_arr(int, 8, .allocator = &counting);
+    arrappend(a, 1);
+    sfree(u);
+    sfree(a);
+    ASSERT_EQ(2, deallocs);
+    // not on the inline path, but still through the same allocator
+    int *d = unique_ptr(int, 3, count_dtor, .allocator = &counting);
+    sfree(d);
+    ASSERT_EQ(3, deallocs);
+    PASS();
+}
+
+GREATEST_SUITE(fast_path_suite) {
+    RUN_TEST(fast_unique);
+    RUN_TEST(fast_with_dtor);
+    RUN_TEST(fast_honours_thread_allocator);
+    RUN_TEST(inline_sfree_uses_block_allocator);
+}
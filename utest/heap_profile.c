@@ -0,0 +1,121 @@
+#include "utils.h"
+
+#ifdef CSPTR_HEAP_PROFILE
+typedef struct {
+    char bytes[100];
+} blob;
+
+/* the bytes the dump gives the call site `func;file:line`, 0 if absent;
+ * a second line for the same site counts as -1 */
+static long long site_bytes_in_(const char *file, const char *func, int line) {
+    char *text = NULL, site[256];
+    size_t size = 0;
+    FILE *out = open_memstream(&text, &size);
+    csptr_heap_profile_dump(out);
+    fclose(out);
+    snprintf(site, sizeof site, "%s;%s:%d ", func, file, line);
+    const char *hit = strstr(text, site);
+    const long long bytes = !hit ? 0 : strstr(hit + 1, site) ? -1 : atoll(hit + strlen(site));
+    free(text);
+    return bytes;
+}
+
+static long long site_bytes_(const char *func, int line) {
+    return site_bytes_in_(__FILE__, func, line);
+}
+
+TEST profile_attributes_call_sites(void) {
+    const size_t prev = csptr_heap_profile_rate(1);
+    const int line = __LINE__ + 1;
+    blob *b = shared_ptr(blob, {{0}});
+    const int arr_line = __LINE__ + 1;
+    int *a = unique_arr(int, 256);
+    ASSERT_LT(100, site_bytes_(__func__, line));
+    ASSERT_GT(200, site_bytes_(__func__, line));
+    ASSERT_LT(1024, site_bytes_(__func__, arr_line));
+    sfree(b);
+    sfree(a);
+    ASSERT_EQ(0, site_bytes_(__func__, line));
+    ASSERT_EQ(0, site_bytes_(__func__, arr_line));
+    csptr_heap_profile_rate(prev);
+    PASS();
+}
+
+TEST profile_covers_fast_path(void) {
+    const size_t prev = csptr_heap_profile_rate(1);
+    const blob value = {{0}};
+    const int line = __LINE__ + 1;
+    blob *b = smalloc_fast_(sizeof (blob), UNIQUE, NULL, &value);
+    ASSERT_LT(100, site_bytes_(__func__, line));
+    // sampled: the inline sfree hands it to sfree_impl_
+    sfree(b);
+    ASSERT_EQ(0, site_bytes_(__func__, line));
+    csptr_heap_profile_rate(prev);
+    PASS();
+}
+
+TEST profile_follows_array_growth(void) {
+    const size_t prev = csptr_heap_profile_rate(1);
+    const int line = __LINE__ + 1;
+    char *a = unique_arr(char, 16);
+    const long long before = site_bytes_(__func__, line);
+    arrreserve(a, 1 << 16);
+    ASSERT_LT(before + (1 << 15), site_bytes_(__func__, line));
+    sfree(a);
+    ASSERT_EQ(0, site_bytes_(__func__, line));
+    csptr_heap_profile_rate(prev);
+    PASS();
+}
+
+/* a call site in a header gets its own copy of __FILE__ in every
+ * translation unit that includes it */
+static const char header_a[] = "shared_header.h", header_b[] = "shared_header.h";
+
+static void *alloc_at_(const char *file) {
+    return smalloc_impl_(&(s_smalloc_args) {CSPTR_SENTINEL .item_size = 64, .item_cap = 1, .kind = UNIQUE,
+                                            .site_file = file, .site_func = "inlined", .site_line = 7});
+}
+
+TEST profile_merges_site_copies(void) {
+    const size_t prev = csptr_heap_profile_rate(1);
+    void *a = alloc_at_(header_a), *b = alloc_at_(header_b);
+    const long long both = site_bytes_in_(header_a, "inlined", 7);
+    sfree(b);
+    const long long one = site_bytes_in_(header_a, "inlined", 7);
+    ASSERT_LT(0, one);
+    ASSERT_EQ(2 * one, both);
+    sfree(a);
+    ASSERT_EQ(0, site_bytes_in_(header_a, "inlined", 7));
+    csptr_heap_profile_rate(prev);
+    PASS();
+}
+
+#define SAMPLED_BLOCKS 20000
+
+TEST profile_estimates_live_bytes(void) {
+    static blob *live[SAMPLED_BLOCKS];
+    const size_t prev = csptr_heap_profile_rate(16 * 1024);
+    const int line = __LINE__ + 2;
+    for (int i = 0; i < SAMPLED_BLOCKS; ++i)
+        live[i] = unique_ptr(blob, {{0}});
+    // each block is 100 bytes of payload plus its header
+    const long long estimate = site_bytes_(__func__, line);
+    ASSERT_LT(SAMPLED_BLOCKS * 100 * 8 / 10, estimate);
+    ASSERT_GT(SAMPLED_BLOCKS * 160 * 12 / 10, estimate);
+    for (int i = 0; i < SAMPLED_BLOCKS; ++i)
+        sfree(live[i]);
+    ASSERT_EQ(0, site_bytes_(__func__, line));
+    csptr_heap_profile_rate(prev);
+    PASS();
+}
+#endif /* CSPTR_HEAP_PROFILE */
+
+GREATEST_SUITE(heap_profile_suite) {
+#ifdef CSPTR_HEAP_PROFILE
+    RUN_TEST(profile_attributes_call_sites);
+    RUN_TEST(profile_covers_fast_path);
+    RUN_TEST(profile_follows_array_growth);
+    RUN_TEST(profile_estimates_live_bytes);
+    RUN_TEST(profile_merges_site_copies);
+#endif
+}
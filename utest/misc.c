@@ -30,14 +30,16 @@ TEST null_ptr(void) {
 
 #ifndef SMALLOC_FIXED_ALLOCATOR
 TEST alloc_failure(void) {
+    const s_allocator prev = smalloc_allocator;
     smalloc_allocator = (s_allocator) {
         lambda(void*, (UNUSED size_t s) { return NULL; }),
         lambda(void, (UNUSED void *ptr) {}),
-        lambda(void*, (UNUSED void* p, UNUSED size_t sz) {return NULL; })
+        lambda(void*, (UNUSED void* p, UNUSED size_t sz) {return NULL; }),
+        NULL
     };
     smart void *ptr = unique_ptr(int, 42);
     ASSERT_EQm("Expected NULL pointer to be returned.", NULL, ptr);
-    smalloc_allocator = (s_allocator){malloc, free, realloc};
+    smalloc_allocator = prev;
     PASS();
 }
 #endif
@@ -0,0 +1,62 @@
+#include "utils.h"
+#include "../mmap_allocator.h"
+
+static const s_mmap_allocator small_threshold = { .threshold = 4096 };
+static const s_mmap_allocator small_threshold_thp = { .threshold = 4096, .huge_pages = 1 };
+
+TEST mmap_blocks_below_threshold(void) {
+    const s_alloc_handle handle = MMAP_HANDLE_OF(&small_threshold);
+    smart int *p = unique_ptr(int, 42, .allocator = &handle);
+    CHECK_CALL(assert_valid_ptr(p));
+    ASSERT_EQ(42, *p);
+
+    char *raw = mmap_alloc((void *) &small_threshold, 100);
+    raw = mmap_realloc((void *) &small_threshold, raw, 200);
+    ASSERT_NEQ(NULL, raw);
+    mmap_dealloc((void *) &small_threshold, raw);
+    PASS();
+}
+
+static enum greatest_test_res append_many(const s_alloc_handle *handle) {
+    const uint32_t N = 200000;
+    smart uint32_t *a = unique_arr(uint32_t, 4, .allocator = handle);
+    for (uint32_t i = 0; i < N; ++i)
+        arrappend(a, i * 3);
+    ASSERT_EQ(N, static_array.length(a));
+    for (uint32_t i = 0; i < N; ++i)
+        ASSERT_EQ_FMT(i * 3, a[i], "%u");
+    PASS();
+}
+
+TEST mmap_array_grows_past_threshold(void) {
+    const s_alloc_handle handle = MMAP_HANDLE_OF(&small_threshold);
+    CHECK_CALL(append_many(&handle));
+    PASS();
+}
+
+TEST mmap_array_grows_with_huge_pages(void) {
+    const s_alloc_handle handle = MMAP_HANDLE_OF(&small_threshold_thp);
+    CHECK_CALL(append_many(&handle));
+    PASS();
+}
+
+TEST mmap_array_keeps_alignment(void) {
+    const s_alloc_handle handle = MMAP_HANDLE_OF(&small_threshold);
+    smart double *a = shared_arr(double, 1, .allocator = &handle, .alignment = 64,
+                                 .userdata = { &g_metadata, sizeof(g_metadata) });
+    for (int i = 0; i < 10000; ++i) {
+        arrappend(a, i * 0.5);
+        ASSERT_EQ(0, (uintptr_t) a % 64);
+    }
+    for (int i = 0; i < 10000; ++i)
+        ASSERT_EQ(i * 0.5, a[i]);
+    CHECK_CALL(assert_valid_meta(&g_metadata, get_smart_ptr_userdata(a)));
+    PASS();
+}
+
+GREATEST_SUITE(mmap_allocator_suite) {
+    RUN_TEST(mmap_blocks_below_threshold);
+    RUN_TEST(mmap_array_grows_past_threshold);
+    RUN_TEST(mmap_array_grows_with_huge_pages);
+    RUN_TEST(mmap_array_keeps_alignment);
+}
@@ -70,6 +70,149 @@ TEST array_insert(void) {
     ASSERT_EQ(MAGIC_NUM, arrlast(a));
     PASS();
 }
+TEST array_appendn(void) {
+    const size_t len = LEN(A);
+    smart int *a = shared_arr(int, 2);
+    arrappend(a, 0);
+    arrappendn(a, A, len);
+    ASSERT_EQ(len + 1, static_array.length(a));
+    ASSERT_EQ(0, a[0]);
+    for (size_t i = 0; i < len; ++i)
+        ASSERT_EQ(A[i], a[1 + i]);
+    arrappendn(a, A, 0);
+    ASSERT_EQ(len + 1, static_array.length(a));
+    PASS();
+}
+
+TEST array_insn_values(void) {
+    static const int B[] = {100, 200, 300};
+    const size_t len = LEN(A);
+    smart int *a = shared_arr(int, len, A);
+    arrinsn_values(a, 2, B, LEN(B));
+    ASSERT_EQ(len + LEN(B), static_array.length(a));
+    ASSERT_EQ(A[0], a[0]);
+    ASSERT_EQ(A[1], a[1]);
+    for (size_t i = 0; i < LEN(B); ++i)
+        ASSERT_EQ(B[i], a[2 + i]);
+    for (size_t i = 2; i < len; ++i)
+        ASSERT_EQ(A[i], a[LEN(B) + i]);
+    PASS();
+}
+
+TEST array_extend(void) {
+    const size_t len = LEN(A);
+    smart int *a = shared_arr(int, 1);
+    smart int *b = shared_arr(int, len, A);
+    arrextend(a, b);
+    assert_eq_arrays(A, a);
+    // from itself, while it moves to a bigger block
+    arrextend(a, a);
+    ASSERT_EQ(2 * len, static_array.length(a));
+    for (size_t i = 0; i < 2 * len; ++i)
+        ASSERT_EQ(A[i % len], a[i]);
+    PASS();
+}
+
+static int fail_realloc;
+
+static void *failing_alloc(UNUSED void *ctx, size_t size) {
+    return malloc(size);
+}
+
+static void failing_dealloc(UNUSED void *ctx, void *ptr) {
+    free(ptr);
+}
+
+static void *failing_realloc(UNUSED void *ctx, void *ptr, size_t size) {
+    return fail_realloc ? NULL : realloc(ptr, size);
+}
+
+TEST array_bulk_failure_keeps_array(void) {
+    static const s_alloc_handle failing = {failing_alloc, failing_dealloc, failing_realloc, NULL, NULL};
+    const size_t len = LEN(A);
+    smart int *a = unique_arr(int, 4, .allocator = &failing);
+    arrappendn(a, A, 4);
+    int *const before = a;
+
+    fail_realloc = 1;
+    arrappendn(a, A, len);
+    ASSERT_EQ(before, a);
+    ASSERT_EQ(4, static_array.length(a));
+    arrinsn_values(a, 0, A, len);
+    ASSERT_EQ(before, a);
+    arrextend(a, a);
+    ASSERT_EQ(before, a);
+    ASSERT_EQ(4, static_array.length(a));
+    ASSERT_MEM_EQ(A, a, 4 * sizeof (int));
+
+    fail_realloc = 0;
+    arrextend(a, a);
+    ASSERT_EQ(8, static_array.length(a));
+    PASS();
+}
+
+TEST array_insn_self(void) {
+    static const int B[] = {0, 1, 2, 3, 4, 5};
+    smart int *a = shared_arr(int, LEN(B), B);
+    // {1, 2, 3} into index 2: the source straddles the insertion point
+    arrinsn_values(a, 2, a + 1, 3);
+    static const int expected[] = {0, 1, 1, 2, 3, 2, 3, 4, 5};
+    ASSERT_EQ(LEN(expected), static_array.length(a));
+    assert_eq_arrays(expected, a);
+    PASS();
+}
+TEST array_delswap(void) {
+    const size_t len = LEN(A);
+    smart int *a = shared_arr(int, len, A);
+    arrdelswap(a, 1);
+    ASSERT_EQ(len - 1, static_array.length(a));
+    ASSERT_EQ(A[len - 1], a[1]);
+    ASSERT_EQ(A[len - 2], arrlast(a));
+    // the last item just goes
+    arrdelswap(a, len - 2);
+    ASSERT_EQ(len - 2, static_array.length(a));
+    ASSERT_EQ(A[len - 3], arrlast(a));
+    PASS();
+}
+
+static int is_odd(const void *item, void *ctx) {
+    ++*(int *) ctx;
+    return *(const int *) item & 1;
+}
+
+static int removed_sum;
+
+static void sum_dtor(void *ptr, UNUSED void *userdata) {
+    removed_sum += *(int *) ptr;
+}
+
+TEST array_remove_if(void) {
+    const size_t len = LEN(A);
+    smart int *a = shared_arr(int, len, A, sum_dtor);
+    int calls = 0, odd_sum = 0;
+    size_t evens = 0;
+    for (size_t i = 0; i < len; ++i) {
+        if (A[i] & 1)
+            odd_sum += A[i];
+        else
+            ++evens;
+    }
+    removed_sum = 0;
+    ASSERT_EQ(len - evens, arr_remove_if(a, is_odd, &calls));
+    ASSERT_EQ((int) len, calls);
+    ASSERT_EQ(odd_sum, removed_sum);
+    ASSERT_EQ(evens, static_array.length(a));
+    for (size_t i = 0, j = 0; i < len; ++i)
+        if (!(A[i] & 1))
+            ASSERT_EQ(A[i], a[j++]);
+
+    // nothing left to drop
+    removed_sum = 0;
+    ASSERT_EQ(0u, arr_remove_if(a, is_odd, &calls));
+    ASSERT_EQ(0, removed_sum);
+    ASSERT_EQ(evens, static_array.length(a));
+    PASS();
+}
 
 
 GREATEST_SUITE(primitive_dynamic_array) {
@@ -77,4 +220,11 @@ GREATEST_SUITE(primitive_dynamic_array) {
         RUN_TEST(array_delete1);
         RUN_TEST(array_deleten);
         RUN_TEST(array_insert);
+        RUN_TEST(array_appendn);
+        RUN_TEST(array_insn_values);
+        RUN_TEST(array_extend);
+        RUN_TEST(array_insn_self);
+        RUN_TEST(array_bulk_failure_keeps_array);
+        RUN_TEST(array_delswap);
+        RUN_TEST(array_remove_if);
 }
\ No newline at end of file
@@ -0,0 +1,95 @@
+#include "utils.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+static atomic_int dtor_calls;
+static _Atomic(pthread_t) dtor_thread;
+
+static void count_dtor(UNUSED void *ptr, UNUSED void *userdata) {
+    atomic_store(&dtor_thread, pthread_self());
+    ++dtor_calls;
+}
+
+TEST reclaim_runs_dtor_elsewhere(void) {
+    dtor_calls = 0;
+    ASSERT_EQ(CSPTR_RECLAIM_OFF, csptr_reclaim_defer(CSPTR_RECLAIM_ALL));
+    int *p = shared_ptr(int, 1, count_dtor);
+    sfree(p);
+    csptr_reclaim_flush();
+    ASSERT_EQ(CSPTR_RECLAIM_ALL, csptr_reclaim_defer(CSPTR_RECLAIM_OFF));
+    ASSERT_EQ(1, dtor_calls);
+    ASSERTm("Expected the reclaimer thread to run the destructor",
+            !pthread_equal(pthread_self(), atomic_load(&dtor_thread)));
+    PASS();
+}
+
+TEST reclaim_flush_drains_all(void) {
+    dtor_calls = 0;
+    csptr_reclaim_defer(CSPTR_RECLAIM_ALL);
+    // more than the queue holds: the overflow is released inline
+    for (int i = 0; i < 3 * CSPTR_RECLAIM_QUEUE; ++i)
+        sfree(unique_ptr(int, i, count_dtor));
+    csptr_reclaim_flush();
+    csptr_reclaim_defer(CSPTR_RECLAIM_OFF);
+    ASSERT_EQ(3 * CSPTR_RECLAIM_QUEUE, dtor_calls);
+    PASS();
+}
+
+TEST reclaim_batch_release(void) {
+    dtor_calls = 0;
+    void *p[8];
+    for (int i = 0; i < 8; ++i)
+        p[i] = shared_ptr(int, i, count_dtor);
+    csptr_reclaim_defer(CSPTR_RECLAIM_ALL);
+    sfree_many(p, 8);
+    csptr_reclaim_flush();
+    csptr_reclaim_defer(CSPTR_RECLAIM_OFF);
+    ASSERT_EQ(8, dtor_calls);
+    PASS();
+}
+
+TEST reclaim_off_is_inline(void) {
+    dtor_calls = 0;
+    csptr_reclaim_defer(CSPTR_RECLAIM_OFF);
+    sfree(shared_ptr(int, 1, count_dtor));
+    ASSERT_EQ(1, dtor_calls);
+    ASSERT(pthread_equal(pthread_self(), atomic_load(&dtor_thread)));
+    // deferral is per thread, local pointers never leave theirs
+    csptr_reclaim_defer(CSPTR_RECLAIM_ALL);
+    sfree(shared_local_ptr(int, 1, count_dtor));
+    csptr_reclaim_defer(CSPTR_RECLAIM_OFF);
+    ASSERT_EQ(2, dtor_calls);
+    PASS();
+}
+
+typedef struct {
+    int *local;
+} holder;
+
+static void holder_dtor(void *ptr, UNUSED void *userdata) {
+    atomic_store(&dtor_thread, pthread_self());
+    sfree(((holder *) ptr)->local);
+}
+
+TEST reclaim_plain_keeps_dtors_inline(void) {
+    dtor_calls = 0;
+    int *local = shared_local_ptr(int, 1, count_dtor);
+    csptr_reclaim_defer(CSPTR_RECLAIM_PLAIN);
+    // its destructor drops a SHARED_LOCAL child, which must stay on this thread
+    sfree(shared_ptr(holder, {local}, holder_dtor));
+    ASSERT_EQ(1, dtor_calls);
+    ASSERT(pthread_equal(pthread_self(), atomic_load(&dtor_thread)));
+    // without a destructor the block still goes to the reclaimer
+    sfree(shared_ptr(int, 2));
+    csptr_reclaim_flush();
+    ASSERT_EQ(CSPTR_RECLAIM_PLAIN, csptr_reclaim_defer(CSPTR_RECLAIM_OFF));
+    PASS();
+}
+
+GREATEST_SUITE(reclaim_suite) {
+    RUN_TEST(reclaim_runs_dtor_elsewhere);
+    RUN_TEST(reclaim_flush_drains_all);
+    RUN_TEST(reclaim_batch_release);
+    RUN_TEST(reclaim_off_is_inline);
+    RUN_TEST(reclaim_plain_keeps_dtors_inline);
+}
@@ -0,0 +1,48 @@
+#include "utils.h"
+
+static size_t dtor_calls;
+
+static void count_dtor(UNUSED void *ptr, UNUSED void *userdata) {
+    ++dtor_calls;
+}
+
+TEST shared_local_refcount(void) {
+    dtor_calls = 0;
+    int *p = shared_local_ptr(int, 42, count_dtor);
+    CHECK_CALL(assert_valid_ptr(p));
+    ASSERT_EQ(42, *p);
+
+    for (int i = 0; i < 100; ++i)
+        sref(p);
+    for (int i = 0; i < 100; ++i)
+        sfree(p);
+    ASSERT_EQm("Expected the object to outlive its extra references", 0, dtor_calls);
+    ASSERT_EQ(42, *p);
+
+    sfree(p);
+    ASSERT_EQ(1, dtor_calls);
+    PASS();
+}
+
+TEST shared_local_array(void) {
+    dtor_calls = 0;
+    const int values[] = {1, 2, 3};
+    int *a = shared_local_arr(int, LEN(values), values, count_dtor);
+    arrappend(a, 4);
+    {
+        smart int *b = sref(a);
+        ASSERT_EQ(4, b[3]);
+    }
+    ASSERT_EQ(4, static_array.length(a));
+    for (size_t i = 0; i < LEN(values); ++i)
+        ASSERT_EQ(values[i], a[i]);
+    ASSERT_EQ(4, a[3]);
+    sfree(a);
+    ASSERT_EQm("Expected one destructor call per element", 4, dtor_calls);
+    PASS();
+}
+
+GREATEST_SUITE(shared_local_suite) {
+    RUN_TEST(shared_local_refcount);
+    RUN_TEST(shared_local_array);
+}
@@ -0,0 +1,148 @@
+#include "utils.h"
+#include "../slab_allocator.h"
+#include <pthread.h>
+#include <sched.h>
+
+static const int A[] = {1, 3, 5, 7, 9, 2, 4, 6, 8, 10, 11};
+
+TEST slab_reuses_freed_block(void) {
+    void *a = slab_alloc(40);
+    ASSERT_NEQ(NULL, a);
+    CHECK_CALL(assert_valid_ptr(a));
+    slab_dealloc(a);
+    void *b = slab_alloc(33);
+    ASSERT_EQm("Expected same size class to hand back the cached block", a, b);
+    slab_dealloc(b);
+    PASS();
+}
+
+TEST slab_realloc_keeps_content(void) {
+    unsigned char *p = slab_alloc(16);
+    for (int i = 0; i < 16; ++i) p[i] = (unsigned char) i;
+
+    p = slab_realloc(p, 200);
+    for (int i = 0; i < 16; ++i) ASSERT_EQ(i, p[i]);
+    for (int i = 16; i < 200; ++i) p[i] = (unsigned char) i;
+
+    p = slab_realloc(p, 4 * SLAB_MAX_SIZE);
+    for (int i = 0; i < 200; ++i) ASSERT_EQ(i, p[i]);
+
+    p = slab_realloc(p, 8 * SLAB_MAX_SIZE);
+    for (int i = 0; i < 200; ++i) ASSERT_EQ(i, p[i]);
+    slab_dealloc(p);
+    PASS();
+}
+
+TEST slab_backs_smart_pointers(void) {
+    const s_allocator prev = smalloc_allocator;
+    smalloc_allocator = slab_allocator;
+    {
+        smart int *u = unique_ptr(int, 42);
+        CHECK_CALL(assert_valid_ptr(u));
+        ASSERT_EQ(42, *u);
+
+        smart int *s = shared_ptr(int, 7);
+        autoclean int *s2 = sref(s);
+        ASSERT_EQ(7, *s2);
+
+        smart int *a = shared_arr(int, 2);
+        for (size_t i = 0; i < LEN(A); ++i)
+            arrappend(a, A[i]);
+        ASSERT_EQ(LEN(A), static_array.length(a));
+        assert_eq_arrays(A, a);
+    }
+    slab_thread_flush();
+    smalloc_allocator = prev;
+    PASS();
+}
+
+static void *slab_churn(void *arg) {
+    void *blocks[256];
+    for (int round = 0; round < 64; ++round) {
+        for (size_t i = 0; i < LEN(blocks); ++i) {
+            blocks[i] = slab_alloc(8 + (i % 96) * 8);
+            if (!blocks[i]) return arg;
+            memset(blocks[i], (int) i, 8);
+        }
+        for (size_t i = 0; i < LEN(blocks); ++i) {
+            if (*(unsigned char *) blocks[i] != (unsigned char) i) return arg;
+            slab_dealloc(blocks[i]);
+        }
+    }
+    return NULL;
+}
+
+TEST slab_threads_share_central_lists(void) {
+    pthread_t th[4];
+    int failed = 0;
+    for (size_t i = 0; i < LEN(th); ++i)
+        pthread_create(&th[i], NULL, slab_churn, &failed);
+    for (size_t i = 0; i < LEN(th); ++i) {
+        void *res;
+        pthread_join(th[i], &res);
+        ASSERT_EQm("Expected blocks to stay private to their owner", NULL, res);
+    }
+    PASS();
+}
+
+static void *dealloc_on_other_thread(void *ptr) {
+    slab_dealloc(ptr);
+    return NULL;
+}
+
+TEST slab_remote_free_returns_to_owner(void) {
+    void *a = slab_alloc(40);
+    // an empty cache: the next allocation looks at the remote list first
+    slab_thread_flush();
+    pthread_t th;
+    pthread_create(&th, NULL, dealloc_on_other_thread, a);
+    pthread_join(th, NULL);
+    void *b = slab_alloc(40);
+    ASSERT_EQm("Expected the block freed elsewhere to come back to its owner", a, b);
+    slab_dealloc(b);
+    slab_thread_flush();
+    PASS();
+}
+
+#define HANDOFF 4096
+
+static void *consume(void *arg) {
+    void **ring = arg;
+    for (int i = 0; i < HANDOFF; ++i) {
+        void *p;
+        while (!(p = __atomic_exchange_n(&ring[i % 64], NULL, __ATOMIC_ACQUIRE)))
+            sched_yield();
+        if (*(int *) p != i)
+            return arg;
+        slab_dealloc(p);
+    }
+    return NULL;
+}
+
+TEST slab_producer_consumer(void) {
+    void *ring[64] = {0};
+    pthread_t th;
+    pthread_create(&th, NULL, consume, ring);
+    for (int i = 0; i < HANDOFF; ++i) {
+        int *p = slab_alloc(8 + (i % 4) * 8);
+        ASSERT_NEQ(NULL, p);
+        *p = i;
+        while (__atomic_load_n(&ring[i % 64], __ATOMIC_RELAXED))
+            sched_yield();
+        __atomic_store_n(&ring[i % 64], p, __ATOMIC_RELEASE);
+    }
+    void *res;
+    pthread_join(th, &res);
+    ASSERT_EQm("Expected every message intact on the consumer", NULL, res);
+    slab_thread_flush();
+    PASS();
+}
+
+GREATEST_SUITE(slab_allocator_suite) {
+    RUN_TEST(slab_reuses_freed_block);
+    RUN_TEST(slab_realloc_keeps_content);
+    RUN_TEST(slab_backs_smart_pointers);
+    RUN_TEST(slab_threads_share_central_lists);
+    RUN_TEST(slab_remote_free_returns_to_owner);
+    RUN_TEST(slab_producer_consumer);
+}
@@ -0,0 +1,140 @@
+#include "utils.h"
+#include <pthread.h>
+
+#ifdef CSPTR_STATS
+static size_t live_(const csptr_stats *s) {
+    size_t live = s->header_bytes;
+    for (int k = 0; k < CSPTR_STATS_KINDS; ++k)
+        live += s->bytes[k];
+    return live;
+}
+
+TEST stats_count_objects_and_bytes(void) {
+    const csptr_stats before = csptr_stats_snapshot();
+    int *u = unique_ptr(int, 1);
+    double *s = shared_ptr(double, 2.0);
+    csptr_stats now = csptr_stats_snapshot();
+    ASSERT_EQ(before.objects[CSPTR_STATS_UNIQUE] + 1, now.objects[CSPTR_STATS_UNIQUE]);
+    ASSERT_EQ(before.bytes[CSPTR_STATS_UNIQUE] + sizeof (int), now.bytes[CSPTR_STATS_UNIQUE]);
+    ASSERT_EQ(before.objects[CSPTR_STATS_SHARED] + 1, now.objects[CSPTR_STATS_SHARED]);
+    ASSERT_EQ(before.bytes[CSPTR_STATS_SHARED] + sizeof (double), now.bytes[CSPTR_STATS_SHARED]);
+    ASSERT_LT(before.header_bytes, now.header_bytes);
+
+    sfree(u);
+    sfree(s);
+    now = csptr_stats_snapshot();
+    for (int k = 0; k < CSPTR_STATS_KINDS; ++k) {
+        ASSERT_EQ(before.objects[k], now.objects[k]);
+        ASSERT_EQ(before.bytes[k], now.bytes[k]);
+    }
+    ASSERT_EQ(before.header_bytes, now.header_bytes);
+    ASSERT_EQ(before.frees + 2, now.frees);
+    PASS();
+}
+
+TEST stats_count_refs_and_frees(void) {
+    const csptr_stats before = csptr_stats_snapshot();
+    int *p = shared_ptr(int, 1);
+    sref(p);
+    sref_n(p, 3);
+    void *refs[] = {p, p, p, p};
+    sfree_many(refs, 4);
+    sfree(p);
+    const csptr_stats now = csptr_stats_snapshot();
+    ASSERT_EQ(before.refs + 4, now.refs);
+    ASSERT_EQ(before.frees + 5, now.frees);
+    ASSERT_EQ(before.objects[CSPTR_STATS_SHARED], now.objects[CSPTR_STATS_SHARED]);
+    PASS();
+}
+
+TEST stats_track_array_growth(void) {
+    const csptr_stats before = csptr_stats_snapshot();
+    int *a = unique_arr(int, 1);
+    arrsetgrowth(a, ARR_GROW_EXACT);
+    for (int i = 0; i < 10; ++i)
+        arrappend(a, i);
+    csptr_stats now = csptr_stats_snapshot();
+    // usable size slack can save some of the 9 reallocations
+    ASSERT_LT(before.array_grows, now.array_grows);
+    ASSERT_GTE(before.array_grows + 9, now.array_grows);
+    ASSERT_EQ(before.objects[CSPTR_STATS_ARRAY] + 1, now.objects[CSPTR_STATS_ARRAY]);
+    ASSERT_EQ(before.bytes[CSPTR_STATS_ARRAY] + arrcap(a) * sizeof (int), now.bytes[CSPTR_STATS_ARRAY]);
+    arrshrink(a);
+    sfree(a);
+    now = csptr_stats_snapshot();
+    ASSERT_EQ(before.bytes[CSPTR_STATS_ARRAY], now.bytes[CSPTR_STATS_ARRAY]);
+    ASSERT_EQ(before.header_bytes, now.header_bytes);
+    PASS();
+}
+
+TEST stats_balance_aligned_blocks(void) {
+    static const char tag[] = "userdata";
+    const csptr_stats before = csptr_stats_snapshot();
+    short *p = shared_ptr(short, 5, .alignment = 64, .userdata = { tag, sizeof tag });
+    double *a = unique_arr(double, 3, .alignment = 32, .userdata = { tag, sizeof tag });
+    arrsetgrowth(a, ARR_GROW_EXACT);
+    for (int i = 0; i < 40; ++i)
+        arrappend(a, i);
+    const csptr_stats now = csptr_stats_snapshot();
+    ASSERT_EQ(before.bytes[CSPTR_STATS_SHARED] + sizeof (short), now.bytes[CSPTR_STATS_SHARED]);
+    ASSERT_EQ(before.bytes[CSPTR_STATS_ARRAY] + arrcap(a) * sizeof (double), now.bytes[CSPTR_STATS_ARRAY]);
+    sfree(p);
+    sfree(a);
+    const csptr_stats after = csptr_stats_snapshot();
+    ASSERT_EQ(before.header_bytes, after.header_bytes);
+    ASSERT_EQ(live_(&before), live_(&after));
+    PASS();
+}
+
+TEST stats_peak_bytes(void) {
+    const csptr_stats before = csptr_stats_snapshot();
+    char *big = unique_arr(char, 1 << 20);
+    sfree(big);
+    const csptr_stats now = csptr_stats_snapshot();
+    ASSERT_LTE(live_(&before) + (1 << 20), now.peak_bytes);
+    ASSERT_EQ(live_(&before), live_(&now));
+    PASS();
+}
+
+static void *free_elsewhere(void *ptr) {
+    sfree(ptr);
+    return NULL;
+}
+
+TEST stats_cross_thread_free(void) {
+    const csptr_stats before = csptr_stats_snapshot();
+    pthread_t th;
+    pthread_create(&th, NULL, free_elsewhere, shared_ptr(long, 3));
+    pthread_join(th, NULL);
+    const csptr_stats now = csptr_stats_snapshot();
+    ASSERT_EQ(before.objects[CSPTR_STATS_SHARED], now.objects[CSPTR_STATS_SHARED]);
+    ASSERT_EQ(live_(&before), live_(&now));
+    ASSERT_EQ(before.frees + 1, now.frees);
+    PASS();
+}
+
+TEST stats_dump(void) {
+    char *text = NULL;
+    size_t size = 0;
+    FILE *out = open_memstream(&text, &size);
+    csptr_stats_dump(out);
+    fclose(out);
+    ASSERT(strstr(text, "unique"));
+    ASSERT(strstr(text, "peak bytes"));
+    ASSERT(strstr(text, "sfree"));
+    free(text);
+    PASS();
+}
+#endif /* CSPTR_STATS */
+
+GREATEST_SUITE(stats_suite) {
+#ifdef CSPTR_STATS
+    RUN_TEST(stats_count_objects_and_bytes);
+    RUN_TEST(stats_count_refs_and_frees);
+    RUN_TEST(stats_track_array_growth);
+    RUN_TEST(stats_balance_aligned_blocks);
+    RUN_TEST(stats_peak_bytes);
+    RUN_TEST(stats_cross_thread_free);
+    RUN_TEST(stats_dump);
+#endif
+}
@@ -2,6 +2,9 @@
 
 #define MY_LIBCSPTR_IMPLEMENTATION
 #include "../csptr.h"
+#include "../slab_allocator.h"
+#include "../mmap_allocator.h"
+#include "../atomic_ptr.h"
 
 const struct my_userdata g_metadata = {1, 2, 3};
 
@@ -12,6 +15,26 @@ SUITE_EXTERN(primitive_static_array);
 SUITE_EXTERN(struct_static_array);
 SUITE_EXTERN(primitive_dynamic_array);
 SUITE_EXTERN(primitive_array2d);
+SUITE_EXTERN(slab_allocator_suite);
+SUITE_EXTERN(arena_suite);
+SUITE_EXTERN(allocator_handle_suite);
+SUITE_EXTERN(alignment_suite);
+SUITE_EXTERN(mmap_allocator_suite);
+SUITE_EXTERN(shared_local_suite);
+SUITE_EXTERN(biased_refcount_suite);
+SUITE_EXTERN(weak_ref_suite);
+SUITE_EXTERN(atomic_ptr_suite);
+SUITE_EXTERN(epoch_suite);
+SUITE_EXTERN(batch_ref_suite);
+SUITE_EXTERN(array_growth_suite);
+SUITE_EXTERN(vec_suite);
+SUITE_EXTERN(fast_path_suite);
+SUITE_EXTERN(array_dtor_suite);
+SUITE_EXTERN(reclaim_suite);
+SUITE_EXTERN(autorelease_suite);
+SUITE_EXTERN(stats_suite);
+SUITE_EXTERN(heap_profile_suite);
+SUITE_EXTERN(trace_suite);
 
 GREATEST_MAIN_DEFS();
 
@@ -25,6 +48,26 @@ int main(int argc, char* argv[]) {
     RUN_SUITE(struct_static_array);
     RUN_SUITE(primitive_dynamic_array);
     RUN_SUITE(primitive_array2d);
+    RUN_SUITE(slab_allocator_suite);
+    RUN_SUITE(arena_suite);
+    RUN_SUITE(allocator_handle_suite);
+    RUN_SUITE(alignment_suite);
+    RUN_SUITE(mmap_allocator_suite);
+    RUN_SUITE(shared_local_suite);
+    RUN_SUITE(biased_refcount_suite);
+    RUN_SUITE(weak_ref_suite);
+    RUN_SUITE(atomic_ptr_suite);
+    RUN_SUITE(epoch_suite);
+    RUN_SUITE(batch_ref_suite);
+    RUN_SUITE(array_growth_suite);
+    RUN_SUITE(vec_suite);
+    RUN_SUITE(fast_path_suite);
+    RUN_SUITE(array_dtor_suite);
+    RUN_SUITE(reclaim_suite);
+    RUN_SUITE(autorelease_suite);
+    RUN_SUITE(stats_suite);
+    RUN_SUITE(heap_profile_suite);
+    RUN_SUITE(trace_suite);
 
     GREATEST_MAIN_END();
 }
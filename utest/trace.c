@@ -0,0 +1,133 @@
+#include "utils.h"
+
+#ifdef CSPTR_TRACE
+#include <pthread.h>
+#include <unistd.h>
+
+typedef struct {
+    csptr_trace_record rec[64];
+    size_t len;
+} trace_log;
+
+static char trace_path_[] = "/tmp/csptr_trace_XXXXXX";
+
+static int trace_start_(void) {
+    int fd = mkstemp(trace_path_);
+    if (fd < 0)
+        return -1;
+    close(fd);
+    return csptr_trace_open(trace_path_);
+}
+
+/* stop tracing and read back what was logged */
+static void trace_stop_(trace_log *log) {
+    csptr_trace_close();
+    FILE *in = fopen(trace_path_, "rb");
+    log->len = in ? fread(log->rec, sizeof *log->rec, 64, in) : 0;
+    if (in)
+        fclose(in);
+    unlink(trace_path_);
+    strcpy(trace_path_ + sizeof trace_path_ - 7, "XXXXXX");
+}
+
+TEST trace_logs_lifetime(void) {
+    trace_log log;
+    ASSERT_EQ(0, trace_start_());
+    int *p = shared_ptr(int, 42);
+    sref(p);
+    sfree(p);
+    sfree(p);
+    trace_stop_(&log);
+
+    ASSERT_EQ(5, log.len);
+    const uint8_t ops[] = {CSPTR_TRACE_ALLOC, CSPTR_TRACE_REF, CSPTR_TRACE_FREE, CSPTR_TRACE_FREE, CSPTR_TRACE_RELEASE};
+    for (size_t i = 0; i < 5; ++i) {
+        ASSERT_EQ(ops[i], log.rec[i].op);
+        ASSERT_EQ(log.rec[0].ptr, log.rec[i].ptr);
+        ASSERT_EQ(log.rec[0].thread, log.rec[i].thread);
+        ASSERT(log.rec[i].kind & SHARED);
+    }
+    ASSERT_LTE(sizeof (int), log.rec[0].size);
+    ASSERT_EQ(1, log.rec[1].arg);
+    ASSERT_EQ(1, log.rec[2].arg);
+    PASS();
+}
+
+TEST trace_follows_array_growth(void) {
+    trace_log log;
+    ASSERT_EQ(0, trace_start_());
+    int *a = unique_arr(int, 1);
+    arrreserve(a, 1000);
+    arrreserve(a, 100000);
+    sfree(a);
+    trace_stop_(&log);
+
+    ASSERT_EQ(5, log.len);
+    ASSERT_EQ(CSPTR_TRACE_ALLOC, log.rec[0].op);
+    ASSERT_EQ(CSPTR_TRACE_REALLOC, log.rec[1].op);
+    ASSERT_EQ(CSPTR_TRACE_REALLOC, log.rec[2].op);
+    ASSERT_EQ(CSPTR_TRACE_FREE, log.rec[3].op);
+    ASSERT_EQ(CSPTR_TRACE_RELEASE, log.rec[4].op);
+    // each realloc moves on from where the last one left the block
+    ASSERT_EQ(log.rec[0].ptr, log.rec[1].ptr);
+    ASSERT_EQ(log.rec[1].arg, log.rec[2].ptr);
+    ASSERT_EQ(log.rec[2].arg, log.rec[3].ptr);
+    ASSERT_EQ(log.rec[2].arg, log.rec[4].ptr);
+    ASSERT_LT(log.rec[0].size, log.rec[1].size);
+    ASSERT_LT(log.rec[1].size, log.rec[2].size);
+    PASS();
+}
+
+TEST trace_counts_batches(void) {
+    trace_log log;
+    ASSERT_EQ(0, trace_start_());
+    int *p = shared_ptr(int, 1);
+    sref_n(p, 3);
+    void *refs[] = {p, p, p, p};
+    sfree_many(refs, 4);
+    trace_stop_(&log);
+
+    ASSERT_EQ(4, log.len);
+    ASSERT_EQ(CSPTR_TRACE_REF, log.rec[1].op);
+    ASSERT_EQ(3, log.rec[1].arg);
+    ASSERT_EQ(CSPTR_TRACE_FREE, log.rec[2].op);
+    ASSERT_EQ(4, log.rec[2].arg);
+    ASSERT_EQ(CSPTR_TRACE_RELEASE, log.rec[3].op);
+    PASS();
+}
+
+static void *alloc_on_other_thread(void *arg) {
+    (void) arg;
+    return shared_ptr(int, 7);
+}
+
+TEST trace_numbers_threads(void) {
+    trace_log log;
+    ASSERT_EQ(0, trace_start_());
+    int *mine = unique_ptr(int, 1);
+    pthread_t th;
+    void *theirs;
+    pthread_create(&th, NULL, alloc_on_other_thread, NULL);
+    pthread_join(th, &theirs);
+    sfree(theirs);
+    sfree(mine);
+    trace_stop_(&log);
+
+    ASSERT_EQ(6, log.len);
+    ASSERT_EQ(CSPTR_TRACE_ALLOC, log.rec[1].op);
+    ASSERT(log.rec[0].thread != log.rec[1].thread);
+    // the free of their block happens here
+    ASSERT_EQ(log.rec[0].thread, log.rec[2].thread);
+    ASSERT_EQ(log.rec[1].ptr, log.rec[2].ptr);
+    PASS();
+}
+#endif /* CSPTR_TRACE */
+
+GREATEST_SUITE(trace_suite) {
+#ifdef CSPTR_TRACE
+    RUN_TEST(trace_logs_lifetime);
+    RUN_TEST(trace_follows_array_growth);
+    RUN_TEST(trace_counts_batches);
+    RUN_TEST(trace_numbers_threads);
+#endif
+}
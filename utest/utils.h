@@ -1,4 +1,6 @@
 #pragma once
+// the suite uses the test-only hooks of csptr.h
+#define CSPTR_TEST_HOOKS
 #include "../csptr.h"
 
 #define GREATEST_USE_LONGJMP 1
@@ -0,0 +1,63 @@
+#include "utils.h"
+
+typedef struct {
+    int id;
+    double weight;
+} item;
+
+CSPTR_DEFINE_VEC(ivec, int)
+CSPTR_DEFINE_VEC(item_vec, item)
+
+TEST vec_push_from_null(void) {
+    smart int *v = NULL;
+    ASSERT_EQ(0, ivec_len(v));
+    ASSERT_EQ(0, ivec_cap(v));
+    for (int i = 0; i < 1000; ++i)
+        ASSERT(ivec_push(&v, i));
+    ASSERT_EQ(1000, ivec_len(v));
+    ASSERT_LTE(1000, ivec_cap(v));
+    for (size_t i = 0; i < ivec_len(v); ++i)
+        ASSERT_EQ((int) i, *ivec_at(v, i));
+    // the same array seen through the generic macros
+    ASSERT_EQ(1000, arrlenu(v));
+    ASSERT_EQ(ivec_cap(v), arrcap(v));
+    PASS();
+}
+
+TEST vec_reserve(void) {
+    smart item *v = NULL;
+    ASSERT(item_vec_reserve(&v, 64));
+    ASSERT_EQ(64, item_vec_cap(v));
+    ASSERT_EQ(0, item_vec_len(v));
+    item *first = v;
+    for (int i = 0; i < 64; ++i)
+        ASSERT(item_vec_push(&v, ((item) {.id = i, .weight = i * 0.5})));
+    ASSERT_EQ_FMTm("Expected no growth within the reserve", (void *) first, (void *) v, "%p");
+    ASSERT(item_vec_reserve(&v, 10));
+    ASSERT_EQ(64, item_vec_cap(v));
+    ASSERT(item_vec_reserve(&v, 200));
+    // the allocator's rounding may add a few items on top
+    ASSERT_LTE(200, item_vec_cap(v));
+    ASSERT_EQ(63, item_vec_at(v, 63)->id);
+    ASSERT_EQ(31.5, item_vec_at(v, 63)->weight);
+    PASS();
+}
+
+TEST vec_over_smart_arr(void) {
+    static const int A[] = {1, 3, 5, 7};
+    smart int *v = shared_arr(int, LEN(A), A, .userdata = {&g_metadata, sizeof g_metadata});
+    ASSERT_EQ(LEN(A), ivec_len(v));
+    ASSERT(ivec_push(&v, 9));
+    arrappend(v, 11);
+    ASSERT_EQ(LEN(A) + 2, ivec_len(v));
+    ASSERT_EQ(9, *ivec_at(v, LEN(A)));
+    ASSERT_EQ(11, *ivec_at(v, LEN(A) + 1));
+    CHECK_CALL(assert_valid_meta(&g_metadata, static_array.userdata(v)));
+    PASS();
+}
+
+GREATEST_SUITE(vec_suite) {
+    RUN_TEST(vec_push_from_null);
+    RUN_TEST(vec_reserve);
+    RUN_TEST(vec_over_smart_arr);
+}
@@ -0,0 +1,112 @@
+#include "utils.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+static atomic_int dtor_calls;
+
+static void count_dtor(void *ptr, UNUSED void *userdata) {
+    *(int *) ptr = -1;
+    ++dtor_calls;
+}
+
+TEST weak_lock_until_destroyed(void) {
+    dtor_calls = 0;
+    int *p = shared_ptr(int, 5, count_dtor);
+    s_weak *w = sweak(p);
+    ASSERT_NEQ(NULL, w);
+
+    int *q = slock(w);
+    ASSERT_EQ(p, q);
+    sfree(q);
+    sfree(p);
+    ASSERT_EQm("Expected the destructor to run with the last strong reference", 1, dtor_calls);
+    ASSERT_EQm("Expected a dead weak reference to fail locking", NULL, slock(w));
+    sweak_free(w);
+    ASSERT_EQ(1, dtor_calls);
+    PASS();
+}
+
+TEST weak_released_first(void) {
+    dtor_calls = 0;
+    int *p = shared_arr(int, 3, ((int[]) {1, 2, 3}), count_dtor);
+    s_weak *w1 = sweak(p), *w2 = sweak(p);
+    sweak_free(w1);
+    sweak_free(w2);
+    ASSERT_EQ(0, dtor_calls);
+    ASSERT_EQ(3, p[2]);
+    sfree(p);
+    ASSERT_EQ(3, dtor_calls);
+    PASS();
+}
+
+TEST weak_local_and_biased(void) {
+    dtor_calls = 0;
+    int *l = shared_local_ptr(int, 1, count_dtor);
+    int *b = shared_biased_ptr(int, 2, count_dtor);
+    s_weak *wl = sweak(l), *wb = sweak(b);
+
+    int *b2 = slock(wb);
+    ASSERT_EQ(b, b2);
+    sfree(b2);
+    sfree(l);
+    sfree(b);
+    ASSERT_EQ(2, dtor_calls);
+    ASSERT_EQ(NULL, slock(wl));
+    ASSERT_EQ(NULL, slock(wb));
+    sweak_free(wl);
+    sweak_free(wb);
+    PASS();
+}
+
+struct lock_race {
+    s_weak *weak;
+    int locked;
+    int bad;
+};
+
+static void *lock_loop(void *arg) {
+    struct lock_race *r = arg;
+    for (int i = 0; i < 100000; ++i) {
+        int *p = slock(r->weak);
+        if (!p)
+            break;
+        ++r->locked;
+        if (*p != 42)
+            ++r->bad;
+        sfree(p);
+    }
+    sweak_free(r->weak);
+    return NULL;
+}
+
+static enum greatest_test_res weak_race(int *p) {
+    dtor_calls = 0;
+    pthread_t t[4];
+    struct lock_race races[LEN(t)];
+    for (size_t i = 0; i < LEN(t); ++i) {
+        races[i] = (struct lock_race) { .weak = sweak(p) };
+        pthread_create(&t[i], NULL, lock_loop, &races[i]);
+    }
+    sched_yield();
+    sfree(p);
+    for (size_t i = 0; i < LEN(t); ++i) {
+        pthread_join(t[i], NULL);
+        ASSERT_EQm("Expected locked objects to be alive", 0, races[i].bad);
+    }
+    sbiased_collect();
+    ASSERT_EQm("Expected exactly one destructor call", 1, dtor_calls);
+    PASS();
+}
+
+TEST weak_concurrent_lock(void) {
+    CHECK_CALL(weak_race(shared_ptr(int, 42, count_dtor)));
+    CHECK_CALL(weak_race(shared_biased_ptr(int, 42, count_dtor)));
+    PASS();
+}
+
+GREATEST_SUITE(weak_ref_suite) {
+    RUN_TEST(weak_lock_until_destroyed);
+    RUN_TEST(weak_released_first);
+    RUN_TEST(weak_local_and_biased);
+    RUN_TEST(weak_concurrent_lock);
+}